@@ -1,44 +1,105 @@
 #include "block.h"
 
-static int block_id = 0;
-static blist_node *created_blocks; // List of all blocks created
+static int num_created_blocks = 0;
+static int blocks_capacity = 0;
+static bnode **created_blocks; // All blocks created, indexed by their ids
+
+// Edges recorded by connect_blocks
+static int num_edges = 0;
+static int edges_capacity = 0;
+static bnode **edge_parents;
+static bnode **edge_children;
+
+// Compressed edges
+static int compressed_capacity = 0;
+static bnode **successor_blocks;
+static bnode **predecessor_blocks;
 
 bnode *create_block() {
-  bnode *block = zalloc(sizeof(bnode));
-  block->id = block_id++;
+  if (num_created_blocks == blocks_capacity) {
+    blocks_capacity = blocks_capacity == 0 ? 16 : 2 * blocks_capacity;
+    created_blocks = realloc(created_blocks, blocks_capacity * sizeof(bnode *));
+  }
 
-  // Add block to the list of created blocks
-  blist_node *block_node = zalloc(sizeof(blist_node));
-  block_node->block = block;
-  block_node->next = created_blocks;
-  created_blocks = block_node;
+  bnode *block = zalloc(sizeof(bnode));
+  block->id = num_created_blocks;
+  created_blocks[num_created_blocks++] = block;
 
   return block;
 }
 
 void connect_blocks(bnode *parent, bnode *child) {
-  // Add child to the parent's child list
-  if (child) {
-    blist_node *child_node = zalloc(sizeof(blist_node));
-    child_node->block = child;
-    child_node->next = parent->children;
-    parent->children = child_node;
+  if (!parent || !child) {
+    return;
+  }
+
+  if (num_edges == edges_capacity) {
+    edges_capacity = edges_capacity == 0 ? 16 : 2 * edges_capacity;
+    edge_parents = realloc(edge_parents, edges_capacity * sizeof(bnode *));
+    edge_children = realloc(edge_children, edges_capacity * sizeof(bnode *));
+  }
+  edge_parents[num_edges] = parent;
+  edge_children[num_edges] = child;
+  num_edges++;
+}
+
+void compress_block_edges() {
+  if (num_edges > compressed_capacity) {
+    compressed_capacity = edges_capacity;
+    successor_blocks =
+        realloc(successor_blocks, compressed_capacity * sizeof(bnode *));
+    predecessor_blocks =
+        realloc(predecessor_blocks, compressed_capacity * sizeof(bnode *));
+  }
+
+  for (int i = 0; i < num_created_blocks; i++) {
+    created_blocks[i]->num_successors = 0;
+    created_blocks[i]->num_predecessors = 0;
+  }
+  for (int i = 0; i < num_edges; i++) {
+    edge_parents[i]->num_successors++;
+    edge_children[i]->num_predecessors++;
+  }
+
+  int num_successors = 0;
+  int num_predecessors = 0;
+  for (int i = 0; i < num_created_blocks; i++) {
+    bnode *block = created_blocks[i];
+    block->successors = successor_blocks + num_successors;
+    block->predecessors = predecessor_blocks + num_predecessors;
+    num_successors += block->num_successors;
+    num_predecessors += block->num_predecessors;
+    block->num_successors = 0;
+    block->num_predecessors = 0;
   }
 
-  // Add parent to the child's parent list
-  if (parent) {
-    blist_node *parent_node = zalloc(sizeof(blist_node));
-    parent_node->block = parent;
-    parent_node->next = child->parents;
-    child->parents = parent_node;
+  // The most recently recorded edges come first
+  for (int i = num_edges - 1; i >= 0; i--) {
+    bnode *parent = edge_parents[i];
+    bnode *child = edge_children[i];
+    parent->successors[parent->num_successors++] = child;
+    child->predecessors[child->num_predecessors++] = parent;
   }
 }
 
 void clear_created_blocks() {
-  block_id = 0;
-  created_blocks = NULL;
+  for (int i = 0; i < num_created_blocks; i++) {
+    bnode *block = created_blocks[i];
+    free_set(block->in);
+    free_set(block->out);
+    free_set(block->saved_registers);
+    free_set(block->restored_registers);
+    while (block->dominated) {
+      blist_node *next = block->dominated->next;
+      free(block->dominated);
+      block->dominated = next;
+    }
+    free(block);
+  }
+  num_created_blocks = 0;
+  num_edges = 0;
 }
 
-int get_num_created_blocks() { return block_id + 1; }
+int get_num_created_blocks() { return num_created_blocks; }
 
-blist_node *get_all_blocks() { return created_blocks; }
\ No newline at end of file
+bnode **get_all_blocks() { return created_blocks; }
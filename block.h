@@ -19,23 +19,31 @@ typedef struct Block {
   struct Instruction* first_instruction;
   struct Instruction* last_instruction;
 
-  blist_node* children;
-  blist_node* parents;
+  // Edges of the control flow graph. They point to ranges of arrays shared by
+  // all the blocks of the function (compressed sparse row storage).
+  struct Block** successors;
+  int num_successors;
+  struct Block** predecessors;
+  int num_predecessors;
 
-  set dominators;
+  int rpo_number; // Position of the block in the reverse postorder of the CFG
 
-  union{
-    set gen;
-    set def;
-  };
+  // Dominator tree
+  struct Block* idom; // Immediate dominator. NULL for the entry block and
+                      // the first blocks of unreachable regions.
+  blist_node* dominated; // Blocks immediately dominated by this one
+  int dom_pre_number; // Preorder and postorder numbers in the dominator tree
+  int dom_post_number;
 
-  union {
-    set kill;
-    set use;
-  };
+  struct Loop* loop; // Innermost loop that contains the block (NULL if none)
 
   set in;
   set out;
+
+  // Callee-saved registers saved at the entry of the block and restored by
+  // its Return instruction (see place_callee_saved_registers)
+  set saved_registers;
+  set restored_registers;
 } bnode;
 
 /**
@@ -46,7 +54,8 @@ typedef struct Block {
 bnode *create_block();
 
 /**
- * Creates a parent to child and a child to parent connections.
+ * Records an edge from a parent block to a child block. The edges only become
+ * visible in the blocks after compress_block_edges is called.
  *
  * @param child: child block
  * @param parent: parent block
@@ -55,7 +64,13 @@ bnode *create_block();
 void connect_blocks(bnode *parent, bnode *child);
 
 /**
- * Clear the list of created blocks and resets the global block ID.
+ * Stores the edges recorded so far in two arrays, one with the successors and
+ * the other with the predecessors of each block, in consecutive positions.
+ */
+void compress_block_edges();
+
+/**
+ * Releases the blocks created and their edges, and resets the global block ID.
  *
  */
 void clear_created_blocks();
@@ -68,10 +83,10 @@ void clear_created_blocks();
 int get_num_created_blocks();
 
 /**
- * Gets the list of all blocks created.
+ * Gets all blocks created.
  *
- * @return Block list head
+ * @return Array of blocks indexed by their ids
  */
-blist_node *get_all_blocks();
+bnode **get_all_blocks();
 
 #endif
@@ -0,0 +1,425 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#include "block_layout.h"
+#include <stdlib.h>
+
+// Probability of the likely successor of a conditional jump
+static double LIKELY_PROBABILITY = 0.9;
+
+// Edge of the control flow graph weighted by its estimated frequency
+typedef struct LayoutEdge {
+  bnode *source;
+  bnode *target;
+  double weight;
+  bool is_fall_through; // Whether the target follows the source in the
+                        // current layout
+} layout_edge;
+
+static bnode **find_fall_through_successors();
+static double get_edge_weight(bnode *block, int successor_index);
+static int classify_successor(bnode *block, bnode *successor);
+static layout_edge *find_weighted_edges(bnode **fall_through, int *num_edges);
+static int compare_edges(const void *edge1, const void *edge2);
+static int find_chain(int *chain_parent, int block_id);
+static bnode **chain_blocks(bnode **fall_through);
+static int compare_chains(const void *block1, const void *block2);
+static void relink_instructions(bnode **layout);
+static void fix_jumps(bnode **layout, bnode **fall_through);
+static inode *get_block_label(bnode *block);
+static void insert_instruction_after(inode *instruction, inode *position);
+
+// Smallest position in the original layout of a block of each chain, used
+// to sort the chains
+static int *chain_position;
+
+void lay_out_blocks(inode *instruction_head) {
+  if (get_num_created_blocks() == 0) {
+    return;
+  }
+
+  bnode **fall_through = find_fall_through_successors();
+  bnode **layout = chain_blocks(fall_through);
+  relink_instructions(layout);
+  fix_jumps(layout, fall_through);
+  free(layout);
+  free(fall_through);
+
+  build_control_flow_graph(instruction_head);
+}
+
+/**
+ * Finds the block the execution continues to when each block does not end
+ * with a jump or when its conditional jump is not taken.
+ *
+ * @return Array indexed by block id with the fall-through successors (NULL if
+ * the block never falls through).
+ */
+bnode **find_fall_through_successors() {
+  int n = get_num_created_blocks();
+  bnode **blocks = get_all_blocks();
+  bnode **fall_through = zalloc(n * sizeof(bnode *));
+
+  for (int i = 0; i < n; i++) {
+    inode *last_live_instruction = NULL;
+    FOR_EACH_INSTRUCTION_IN_BLOCK_REVERSE(instruction, blocks[i]) {
+      if (!instruction->dead) {
+        last_live_instruction = instruction;
+        break;
+      }
+    }
+
+    inode *next = blocks[i]->last_instruction->next;
+    if (next && (!last_live_instruction ||
+                 (last_live_instruction->op_type != OP_Goto &&
+                  last_live_instruction->op_type != OP_Return))) {
+      fall_through[i] = next->block;
+    }
+  }
+
+  return fall_through;
+}
+
+/**
+ * Estimates how much is saved by placing a successor of a block right after
+ * it.
+ *
+ * @param block: block
+ * @param successor_index: index of the successor in the block's successors
+ *
+ * @return Weight of the edge from the block to the successor
+ */
+double get_edge_weight(bnode *block, int successor_index) {
+  double frequency = estimate_block_frequency(block);
+  if (block->num_successors == 1) {
+    // Otherwise, the block needs an unconditional jump
+    return frequency;
+  }
+
+  // A conditional jump costs the same whether it is taken or not, so the
+  // edges of a block that ends with one weigh less than the others. They are
+  // weighted by the probability of being taken.
+  int kind = classify_successor(block, block->successors[successor_index]);
+  int other_kind =
+      classify_successor(block, block->successors[1 - successor_index]);
+  double probability = 0.5;
+  if (kind != other_kind) {
+    probability =
+        kind > other_kind ? LIKELY_PROBABILITY : 1 - LIKELY_PROBABILITY;
+  }
+  if (kind == 0 || other_kind == 0) {
+    // The cycle formed by a loop must be broken somewhere. Breaking it after
+    // a block that exits the loop costs nothing if the exit follows the
+    // block, so these edges weigh even less.
+    probability *= 1 - LIKELY_PROBABILITY;
+  }
+  return frequency * probability / 2;
+}
+
+/**
+ * Classifies the edge from a block to one of its successors according to how
+ * likely it is to be taken.
+ *
+ * @param block: block
+ * @param successor: successor of the block
+ *
+ * @return 2 for loop back edges, 0 for loop exits and 1 otherwise
+ */
+int classify_successor(bnode *block, bnode *successor) {
+  if (dominates(successor, block)) {
+    return 2;
+  }
+  if (block->loop &&
+      !does_elto_belong_to_set(successor->id, block->loop->blocks)) {
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * Lists the edges of the control flow graph, weighted by the estimated
+ * number of times they are taken, from the heaviest to the lightest.
+ *
+ * @param fall_through: fall-through successor of each block
+ * @param num_edges: variable to store the number of edges in
+ *
+ * @return Array of edges
+ */
+layout_edge *find_weighted_edges(bnode **fall_through, int *num_edges) {
+  int n = get_num_created_blocks();
+  bnode **blocks = get_all_blocks();
+
+  *num_edges = 0;
+  for (int i = 0; i < n; i++) {
+    *num_edges += blocks[i]->num_successors;
+  }
+  if (*num_edges == 0) {
+    return NULL;
+  }
+
+  layout_edge *edges = zalloc(*num_edges * sizeof(layout_edge));
+  int e = 0;
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < blocks[i]->num_successors; j++) {
+      if (blocks[i]->num_successors > 1 &&
+          classify_successor(blocks[i], blocks[i]->successors[j]) == 2) {
+        // A conditional back edge is better taken, so that the loop exit
+        // falls through. Otherwise, the cycle formed by the loop would be
+        // broken somewhere else in the loop by an unconditional jump.
+        continue;
+      }
+      edges[e].source = blocks[i];
+      edges[e].target = blocks[i]->successors[j];
+      edges[e].weight = get_edge_weight(blocks[i], j);
+      edges[e].is_fall_through = fall_through[i] == edges[e].target;
+      e++;
+    }
+  }
+  *num_edges = e;
+  qsort(edges, *num_edges, sizeof(layout_edge), compare_edges);
+
+  return edges;
+}
+
+/**
+ * Orders edges by decreasing weight. Ties are broken in favor of the edges
+ * that already fall through, so that the original layout is preserved when
+ * there is no reason to change it.
+ */
+int compare_edges(const void *edge1, const void *edge2) {
+  const layout_edge *e1 = edge1;
+  const layout_edge *e2 = edge2;
+  if (e1->weight != e2->weight) {
+    return e1->weight > e2->weight ? -1 : 1;
+  }
+  if (e1->is_fall_through != e2->is_fall_through) {
+    return e1->is_fall_through ? -1 : 1;
+  }
+  if (e1->source != e2->source) {
+    return e1->source->first_instruction->order -
+           e2->source->first_instruction->order;
+  }
+  return e1->target->first_instruction->order -
+         e2->target->first_instruction->order;
+}
+
+/**
+ * Finds the chain a block belongs to.
+ *
+ * @param chain_parent: union-find forest of chains, indexed by block id
+ * @param block_id: block id
+ *
+ * @return Id of the block that represents the chain
+ */
+int find_chain(int *chain_parent, int block_id) {
+  int root = block_id;
+  while (chain_parent[root] != root) {
+    root = chain_parent[root];
+  }
+  while (chain_parent[block_id] != root) {
+    int next = chain_parent[block_id];
+    chain_parent[block_id] = root;
+    block_id = next;
+  }
+  return root;
+}
+
+/**
+ * Groups the blocks into chains by visiting the edges from the heaviest to the
+ * lightest and appending the target of an edge to the chain of its source,
+ * whenever the source ends its chain and the target starts another one. The
+ * chains are then placed in the order of their first block in the original
+ * layout, with the one with the entry block first.
+ *
+ * @param fall_through: fall-through successor of each block
+ *
+ * @return Array with all blocks in their new order
+ */
+bnode **chain_blocks(bnode **fall_through) {
+  int n = get_num_created_blocks();
+  bnode **blocks = get_all_blocks();
+  bnode **next_in_chain = zalloc(n * sizeof(bnode *));
+  bnode **previous_in_chain = zalloc(n * sizeof(bnode *));
+  int *chain_parent = zalloc(n * sizeof(int));
+  for (int i = 0; i < n; i++) {
+    chain_parent[i] = i;
+  }
+
+  int num_edges;
+  layout_edge *edges = find_weighted_edges(fall_through, &num_edges);
+  for (int e = 0; e < num_edges; e++) {
+    bnode *source = edges[e].source;
+    bnode *target = edges[e].target;
+    if (next_in_chain[source->id] || previous_in_chain[target->id] ||
+        target->first_instruction->op_type == OP_Enter) {
+      continue;
+    }
+
+    int source_chain = find_chain(chain_parent, source->id);
+    int target_chain = find_chain(chain_parent, target->id);
+    if (source_chain != target_chain) {
+      next_in_chain[source->id] = target;
+      previous_in_chain[target->id] = source;
+      chain_parent[target_chain] = source_chain;
+    }
+  }
+  free(edges);
+
+  chain_position = zalloc(n * sizeof(int));
+  for (int i = 0; i < n; i++) {
+    chain_position[i] = -1;
+  }
+  int num_chains = 0;
+  bnode **chain_heads = zalloc(n * sizeof(bnode *));
+  for (int i = 0; i < n; i++) {
+    int chain = find_chain(chain_parent, i);
+    int position = blocks[i]->first_instruction->order;
+    if (chain_position[chain] < 0 || position < chain_position[chain]) {
+      chain_position[chain] = position;
+    }
+    if (!previous_in_chain[i]) {
+      chain_heads[num_chains++] = blocks[i];
+    }
+  }
+  // Chains are sorted by the position of their representative blocks
+  for (int i = 0; i < n; i++) {
+    chain_position[i] = chain_position[find_chain(chain_parent, i)];
+  }
+  qsort(chain_heads, num_chains, sizeof(bnode *), compare_chains);
+
+  bnode **layout = zalloc(n * sizeof(bnode *));
+  int num_placed = 0;
+  for (int i = 0; i < num_chains; i++) {
+    for (bnode *block = chain_heads[i]; block;
+         block = next_in_chain[block->id]) {
+      layout[num_placed++] = block;
+    }
+  }
+
+  free(chain_position);
+  free(chain_heads);
+  free(chain_parent);
+  free(previous_in_chain);
+  free(next_in_chain);
+
+  return layout;
+}
+
+/**
+ * Orders chains by the smallest position of their blocks in the original
+ * layout.
+ */
+int compare_chains(const void *block1, const void *block2) {
+  return chain_position[(*(bnode **)block1)->id] -
+         chain_position[(*(bnode **)block2)->id];
+}
+
+/**
+ * Relinks the instructions of the function so that the blocks appear in a
+ * given order. Instructions that precede the entry block (global
+ * declarations) stay where they are.
+ *
+ * @param layout: blocks in their new order, starting with the entry block
+ */
+void relink_instructions(bnode **layout) {
+  int n = get_num_created_blocks();
+  inode *previous = layout[0]->first_instruction->previous;
+  for (int i = 0; i < n; i++) {
+    layout[i]->first_instruction->previous = previous;
+    if (previous) {
+      previous->next = layout[i]->first_instruction;
+    }
+    previous = layout[i]->last_instruction;
+  }
+  previous->next = NULL;
+}
+
+/**
+ * Updates the jumps at the end of each block so that the execution continues
+ * to the same blocks as before the blocks were reordered. Jumps to the next
+ * block are removed, a conditional jump to the next block is inverted, and a
+ * jump is added when the execution used to fall through to a block that is
+ * no longer next.
+ *
+ * @param layout: blocks in their new order
+ * @param fall_through: fall-through successor of each block in the original
+ * layout
+ */
+void fix_jumps(bnode **layout, bnode **fall_through) {
+  int n = get_num_created_blocks();
+  for (int i = 0; i < n; i++) {
+    bnode *block = layout[i];
+    bnode *next = i + 1 < n ? layout[i + 1] : NULL;
+
+    inode *last_live_instruction = NULL;
+    FOR_EACH_INSTRUCTION_IN_BLOCK_REVERSE(instruction, block) {
+      if (!instruction->dead) {
+        last_live_instruction = instruction;
+        break;
+      }
+    }
+
+    if (last_live_instruction && last_live_instruction->op_type == OP_Goto) {
+      if (last_live_instruction->jump_to->block == next) {
+        last_live_instruction->dead = true;
+      }
+      continue;
+    }
+
+    bnode *successor = fall_through[block->id];
+    if (!successor || successor == next) {
+      continue;
+    }
+
+    if (last_live_instruction && last_live_instruction->op_type == OP_If &&
+        last_live_instruction->jump_to->block == next) {
+      invert_boolean_operator(last_live_instruction);
+      last_live_instruction->jump_to = get_block_label(successor);
+    } else {
+      inode *jump = create_jump_instruction(get_block_label(successor));
+      update_def_and_use_ids(jump);
+      insert_instruction_after(jump, block->last_instruction);
+      jump->block = block;
+      block->last_instruction = jump;
+    }
+  }
+}
+
+/**
+ * Gets the label at the beginning of a block, creating one if necessary.
+ *
+ * @param block: block
+ *
+ * @return Label instruction
+ */
+inode *get_block_label(bnode *block) {
+  if (block->first_instruction->op_type == OP_Label) {
+    // It may have been removed if no jump used it
+    block->first_instruction->dead = false;
+    return block->first_instruction;
+  }
+
+  inode *label = create_label_instruction();
+  update_def_and_use_ids(label);
+  insert_instruction_after(label, block->first_instruction->previous);
+  label->block = block;
+  block->first_instruction = label;
+  return label;
+}
+
+/**
+ * Inserts an instruction in the list of instructions.
+ *
+ * @param instruction: instruction to insert
+ * @param position: instruction after which it is inserted
+ */
+void insert_instruction_after(inode *instruction, inode *position) {
+  instruction->previous = position;
+  instruction->next = position->next;
+  if (position->next) {
+    position->next->previous = instruction;
+  }
+  position->next = instruction;
+}
@@ -0,0 +1,21 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#ifndef CSC553_BLOCK_LAYOUT_H
+#define CSC553_BLOCK_LAYOUT_H
+
+#include "loops.h"
+
+/**
+ * Reorders the blocks of a function so that the most likely successor of a
+ * block comes right after it, and updates the jumps accordingly. Without
+ * profiling information, loop back edges are assumed to be taken and loop
+ * exits not to be taken. The control flow graph is rebuilt afterwards.
+ *
+ * @param instruction_head: first instruction of a function
+ */
+void lay_out_blocks(inode *instruction_head);
+
+#endif // CSC553_BLOCK_LAYOUT_H
@@ -14,21 +14,17 @@
 inode *global_head = NULL;
 inode *global_tail = NULL;
 
-static int LOOP_FREQ = 10;
-
 static void append_child_instructions(tnode *child, tnode *parent);
 static void append_instruction(inode *instruction, tnode *node);
 static void append_instructions(inode *instructions, tnode *node);
+static inode *copy_instructions(inode *first, inode *last);
 static void generate_binary_expr_code(symtabnode *func_header, tnode *node,
-                                      enum InstructionType type, int lr_type,
-                                      int outer_scope_freq);
+                                      enum InstructionType type, int lr_type);
 static void generate_bool_expr_code(symtabnode *func_header, tnode *node,
-                                    inode *label_then, inode *label_else,
-                                    int outer_scope_freq);
+                                    inode *label_then, inode *label_else);
 static enum InstructionType get_boolean_comp_type(SyntaxNodeType node_type);
 static void generate_function_args_code(symtabnode *func_header,
-                                        tnode *call_node, int outer_scope_freq);
-static void collect_var_cost(inode *instruction, int freq);
+                                        tnode *call_node);
 
 void process_function_header(symtabnode *func_header, tnode *body) {
   append_instructions(global_head, body);
@@ -46,8 +42,7 @@ void process_allocations(symtabnode *function_ptr) {
   function_ptr->byte_size = fill_local_allocations();
 }
 
-void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
-                            int outer_scope_freq) {
+void generate_function_code(symtabnode *func_header, tnode *node, int lr_type) {
   inode *instruction;
   symtabnode *tmp;
 
@@ -58,12 +53,10 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
 
   switch (node->ntype) {
   case Assg:
-    generate_function_code(func_header, stAssg_Lhs(node), L_VALUE,
-                           outer_scope_freq);
+    generate_function_code(func_header, stAssg_Lhs(node), L_VALUE);
     append_child_instructions(stAssg_Lhs(node), node);
 
-    generate_function_code(func_header, stAssg_Rhs(node), R_VALUE,
-                           outer_scope_freq);
+    generate_function_code(func_header, stAssg_Rhs(node), R_VALUE);
     append_child_instructions(stAssg_Rhs(node), node);
 
     if (stAssg_Lhs(node)->ntype == ArraySubscript) {
@@ -73,7 +66,6 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
       instruction = create_instruction(OP_Assign, stAssg_Rhs(node)->place, NULL,
                                        stAssg_Lhs(node)->place);
     }
-    collect_var_cost(instruction, outer_scope_freq);
     append_instruction(instruction, node);
 
     // No longer needed after assigned to a variable
@@ -97,7 +89,6 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
       node->place = create_temporary(t_Int);
       tmp = create_constant_variable(t_Int, node->val.iconst);
       instruction = create_instruction(OP_Assign, tmp, NULL, node->place);
-      collect_var_cost(instruction, outer_scope_freq);
       append_instruction(instruction, node);
     }
     break;
@@ -110,7 +101,6 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
       node->place = create_temporary(t_Char);
       tmp = create_constant_variable(t_Char, node->val.iconst);
       instruction = create_instruction(OP_Assign, tmp, NULL, node->place);
-      collect_var_cost(instruction, outer_scope_freq);
       append_instruction(instruction, node);
     }
     break;
@@ -121,7 +111,7 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
 
   case FunCall: {
     // Expand the parameters
-    generate_function_args_code(func_header, node, outer_scope_freq);
+    generate_function_args_code(func_header, node);
     append_child_instructions(stFunCall_Args(node), node);
 
     // Create PARAM instructions
@@ -143,7 +133,6 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
           free_temporary(stList_Head(param)->loc);
         }
       }
-      collect_var_cost(instruction, outer_scope_freq);
       // Actuals from the right to the left
       instruction->next = params_instructions;
       params_instructions = instruction;
@@ -157,7 +146,6 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
     if (function_ptr->ret_type != t_None) {
       node->place = create_temporary(function_ptr->ret_type);
       instruction = create_instruction(OP_Retrieve, NULL, NULL, node->place);
-      collect_var_cost(instruction, outer_scope_freq);
       append_instruction(instruction, node);
     }
     break;
@@ -165,8 +153,7 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
 
   case STnodeList: {
     for (tnode *arg = node; arg != NULL; arg = stList_Rest(arg)) {
-      generate_function_code(func_header, stList_Head(arg), lr_type,
-                             outer_scope_freq);
+      generate_function_code(func_header, stList_Head(arg), lr_type);
       append_child_instructions(stList_Head(arg), node);
     }
     break;
@@ -177,29 +164,24 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
     append_instruction(instruction, node);
 
     if (stReturn(node)) {
-      generate_function_code(func_header, stReturn(node), R_VALUE,
-                             outer_scope_freq);
+      generate_function_code(func_header, stReturn(node), R_VALUE);
       append_child_instructions(stReturn(node), node);
 
       node->place = create_temporary(func_header->ret_type);
       instruction = create_instruction(OP_Assign, stReturn(node)->place, NULL,
                                        node->place);
-      collect_var_cost(instruction, outer_scope_freq);
       append_instruction(instruction, node);
     }
     instruction = create_instruction(OP_Return, node->place, NULL, NULL);
-    collect_var_cost(instruction, outer_scope_freq);
     append_instruction(instruction, node);
     break;
 
   case UnaryMinus:
-    generate_function_code(func_header, stUnop_Op(node), R_VALUE,
-                           outer_scope_freq);
+    generate_function_code(func_header, stUnop_Op(node), R_VALUE);
     append_child_instructions(stUnop_Op(node), node);
     node->place = create_temporary(node->etype);
     instruction = create_instruction(OP_UMinus, stUnop_Op(node)->place, NULL,
                                      node->place);
-    collect_var_cost(instruction, outer_scope_freq);
     append_instruction(instruction, node);
 
     if (stUnop_Op(node)->place->is_temporary) {
@@ -208,23 +190,19 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
     break;
 
   case Plus:
-    generate_binary_expr_code(func_header, node, IT_Plus, R_VALUE,
-                              outer_scope_freq);
+    generate_binary_expr_code(func_header, node, IT_Plus, R_VALUE);
     break;
 
   case BinaryMinus:
-    generate_binary_expr_code(func_header, node, IT_BinaryMinus, R_VALUE,
-                              outer_scope_freq);
+    generate_binary_expr_code(func_header, node, IT_BinaryMinus, R_VALUE);
     break;
 
   case Mult:
-    generate_binary_expr_code(func_header, node, IT_Mult, R_VALUE,
-                              outer_scope_freq);
+    generate_binary_expr_code(func_header, node, IT_Mult, R_VALUE);
     break;
 
   case Div:
-    generate_binary_expr_code(func_header, node, IT_Div, R_VALUE,
-                              outer_scope_freq);
+    generate_binary_expr_code(func_header, node, IT_Div, R_VALUE);
     break;
 
   case If: {
@@ -235,17 +213,16 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
     // Boolean expression
     if (stIf_Else(node)) {
       generate_bool_expr_code(func_header, stIf_Test(node), label_then,
-                              label_else, outer_scope_freq);
+                              label_else);
     } else {
       generate_bool_expr_code(func_header, stIf_Test(node), label_then,
-                              label_after, outer_scope_freq);
+                              label_after);
     }
     append_child_instructions(stIf_Test(node), node);
 
     // Then block
     append_instruction(label_then, node);
-    generate_function_code(func_header, stIf_Then(node), lr_type,
-                           outer_scope_freq);
+    generate_function_code(func_header, stIf_Then(node), lr_type);
     append_child_instructions(stIf_Then(node), node);
 
     if (stIf_Else(node)) {
@@ -255,8 +232,7 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
 
       // Else block
       append_instruction(label_else, node);
-      generate_function_code(func_header, stIf_Else(node), lr_type,
-                             outer_scope_freq);
+      generate_function_code(func_header, stIf_Else(node), lr_type);
       append_child_instructions(stIf_Else(node), node);
     }
 
@@ -266,24 +242,26 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
   }
 
   case While: {
+    // Loops are inverted: the test is evaluated before the first iteration
+    // and at the end of each iteration, so each iteration executes a single
+    // conditional jump.
     inode *label_body = create_label_instruction();
-    inode *label_eval = create_label_instruction();
     inode *label_after = create_label_instruction();
 
-    // Jump to eval
-    instruction = create_jump_instruction(label_eval);
-    append_instruction(instruction, node);
+    generate_function_code(func_header, stWhile_Body(node), lr_type);
+    generate_bool_expr_code(func_header, stWhile_Test(node), label_body,
+                            label_after);
+
+    // Guard
+    append_instructions(copy_instructions(stWhile_Test(node)->code_head,
+                                          stWhile_Test(node)->code_tail),
+                        node);
 
     // Body
-    generate_function_code(func_header, stWhile_Body(node), lr_type,
-                           LOOP_FREQ * outer_scope_freq);
     append_instruction(label_body, node);
     append_child_instructions(stWhile_Body(node), node);
 
     // Eval
-    generate_bool_expr_code(func_header, stWhile_Test(node), label_body,
-                            label_after, LOOP_FREQ * outer_scope_freq);
-    append_instruction(label_eval, node);
     append_child_instructions(stWhile_Test(node), node);
 
     // After the WHILE
@@ -292,35 +270,35 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
   }
 
   case For: {
+    // Inverted like the While loop
     inode *label_body = create_label_instruction();
-    inode *label_eval = create_label_instruction();
     inode *label_after = create_label_instruction();
 
     // Initialization
-    generate_function_code(func_header, stFor_Init(node), lr_type,
-                           outer_scope_freq);
+    generate_function_code(func_header, stFor_Init(node), lr_type);
     append_child_instructions(stFor_Init(node), node);
 
-    // Jump to eval
-    instruction = create_jump_instruction(label_eval);
-    append_instruction(instruction, node);
+    generate_function_code(func_header, stFor_Body(node), lr_type);
+    generate_function_code(func_header, stFor_Update(node), lr_type);
+    if (stFor_Test(node)) {
+      generate_bool_expr_code(func_header, stFor_Test(node), label_body,
+                              label_after);
+
+      // Guard
+      append_instructions(copy_instructions(stFor_Test(node)->code_head,
+                                            stFor_Test(node)->code_tail),
+                          node);
+    }
 
     // Body
-    generate_function_code(func_header, stFor_Body(node), lr_type,
-                           LOOP_FREQ * outer_scope_freq);
     append_instruction(label_body, node);
     append_child_instructions(stFor_Body(node), node);
 
     // Update
-    generate_function_code(func_header, stFor_Update(node), lr_type,
-                           LOOP_FREQ * outer_scope_freq);
     append_child_instructions(stFor_Update(node), node);
 
     // Eval
-    append_instruction(label_eval, node);
     if (stFor_Test(node)) {
-      generate_bool_expr_code(func_header, stFor_Test(node), label_body,
-                              label_after, LOOP_FREQ * outer_scope_freq);
       append_child_instructions(stFor_Test(node), node);
     } else {
       // No condition. Runs forever until stopped internally by a return.
@@ -336,7 +314,7 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
   case ArraySubscript: {
     // Evaluate the node's index as an r-value
     generate_function_code(func_header, stArraySubscript_Subscript(node),
-                           R_VALUE, outer_scope_freq);
+                           R_VALUE);
     append_child_instructions(stArraySubscript_Subscript(node), node);
 
     if (stArraySubscript_Subscript(node)->place->is_temporary) {
@@ -353,7 +331,6 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
     instruction = create_instruction(OP_Index_Array,
                                      stArraySubscript_Subscript(node)->place,
                                      array_node, tmp);
-    collect_var_cost(instruction, outer_scope_freq);
     append_instruction(instruction, node);
 
     if (lr_type == L_VALUE) {
@@ -361,7 +338,6 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
     } else {
       node->place = create_temporary(array_node->elt_type);
       instruction = create_instruction(OP_Deref, tmp, NULL, node->place);
-      collect_var_cost(instruction, outer_scope_freq);
       append_instruction(instruction, node);
     }
 
@@ -374,17 +350,14 @@ void generate_function_code(symtabnode *func_header, tnode *node, int lr_type,
   }
 }
 
-void generate_function_args_code(symtabnode *func_header, tnode *call_node,
-                                 int outer_scope_freq) {
+void generate_function_args_code(symtabnode *func_header, tnode *call_node) {
   symtabnode *formal = stFunCall_Fun(call_node)->formals;
   tnode *arg_node = stFunCall_Args(call_node);
   for (tnode *arg = arg_node; arg != NULL; arg = stList_Rest(arg)) {
     if (formal->type == t_Array) {
-      generate_function_code(func_header, stList_Head(arg), L_VALUE,
-                             outer_scope_freq);
+      generate_function_code(func_header, stList_Head(arg), L_VALUE);
     } else {
-      generate_function_code(func_header, stList_Head(arg), R_VALUE,
-                             outer_scope_freq);
+      generate_function_code(func_header, stList_Head(arg), R_VALUE);
     }
     append_child_instructions(stList_Head(arg), arg_node);
     formal = formal->next;
@@ -392,19 +365,15 @@ void generate_function_args_code(symtabnode *func_header, tnode *call_node,
 }
 
 void generate_binary_expr_code(symtabnode *func_header, tnode *node,
-                               enum InstructionType type, int lr_type,
-                               int outer_scope_freq) {
-  generate_function_code(func_header, stBinop_Op1(node), lr_type,
-                         outer_scope_freq);
+                               enum InstructionType type, int lr_type) {
+  generate_function_code(func_header, stBinop_Op1(node), lr_type);
   append_child_instructions(stBinop_Op1(node), node);
-  generate_function_code(func_header, stBinop_Op2(node), lr_type,
-                         outer_scope_freq);
+  generate_function_code(func_header, stBinop_Op2(node), lr_type);
   append_child_instructions(stBinop_Op2(node), node);
   node->place = create_temporary(node->etype);
   inode *instruction =
       create_expr_instruction(OP_BinaryArithmetic, stBinop_Op1(node)->place,
                               stBinop_Op2(node)->place, node->place, type);
-  collect_var_cost(instruction, outer_scope_freq);
 
   if (stBinop_Op1(node)->place->is_temporary) {
     free_temporary(stBinop_Op1(node)->place);
@@ -417,8 +386,7 @@ void generate_binary_expr_code(symtabnode *func_header, tnode *node,
 }
 
 void generate_bool_expr_code(symtabnode *func_header, tnode *node,
-                             inode *label_true, inode *label_false,
-                             int outer_scope_freq) {
+                             inode *label_true, inode *label_false) {
 
   inode *instruction;
 
@@ -426,9 +394,9 @@ void generate_bool_expr_code(symtabnode *func_header, tnode *node,
   case LogicalAnd: {
     inode *label_next = create_label_instruction();
     generate_bool_expr_code(func_header, stBinop_Op1(node), label_next,
-                            label_false, outer_scope_freq);
+                            label_false);
     generate_bool_expr_code(func_header, stBinop_Op2(node), label_true,
-                            label_false, outer_scope_freq);
+                            label_false);
 
     append_child_instructions(stBinop_Op1(node), node);
     append_instruction(label_next, node);
@@ -438,9 +406,9 @@ void generate_bool_expr_code(symtabnode *func_header, tnode *node,
   case LogicalOr: {
     inode *label_next = create_label_instruction();
     generate_bool_expr_code(func_header, stBinop_Op1(node), label_true,
-                            label_next, outer_scope_freq);
+                            label_next);
     generate_bool_expr_code(func_header, stBinop_Op2(node), label_true,
-                            label_false, outer_scope_freq);
+                            label_false);
 
     append_child_instructions(stBinop_Op1(node), node);
     append_instruction(label_next, node);
@@ -449,7 +417,7 @@ void generate_bool_expr_code(symtabnode *func_header, tnode *node,
   }
   case LogicalNot: {
     generate_bool_expr_code(func_header, stUnop_Op(node), label_false,
-                            label_true, outer_scope_freq);
+                            label_true);
     append_child_instructions(stUnop_Op(node), node);
     break;
   }
@@ -459,8 +427,8 @@ void generate_bool_expr_code(symtabnode *func_header, tnode *node,
   case Gt:
   case Neq:
   case Geq: {
-    generate_function_code(func_header, stBinop_Op1(node), R_VALUE, outer_scope_freq);
-    generate_function_code(func_header, stBinop_Op2(node), R_VALUE, outer_scope_freq);
+    generate_function_code(func_header, stBinop_Op1(node), R_VALUE);
+    generate_function_code(func_header, stBinop_Op2(node), R_VALUE);
 
     append_child_instructions(stBinop_Op1(node), node);
     append_child_instructions(stBinop_Op2(node), node);
@@ -468,7 +436,6 @@ void generate_bool_expr_code(symtabnode *func_header, tnode *node,
     enum InstructionType type = get_boolean_comp_type(node->ntype);
     instruction = create_cond_jump_instruction(
         stBinop_Op1(node)->place, stBinop_Op2(node)->place, label_true, type);
-    collect_var_cost(instruction, outer_scope_freq);
     append_instruction(instruction, node);
 
     instruction = create_jump_instruction(label_false);
@@ -567,16 +534,53 @@ void append_instructions(inode *instructions, tnode *node) {
   }
 }
 
-void collect_var_cost(inode *instruction, int freq) {
-  if (SRC1(instruction)) {
-    SRC1(instruction)->cost += freq;
+/**
+ * Copies a sequence of instructions. Labels in the sequence are replaced by
+ * new labels in the copy, and so are the jumps to them.
+ *
+ * @param first: first instruction of the sequence
+ * @param last: last instruction of the sequence
+ *
+ * @return First instruction of the copy
+ */
+inode *copy_instructions(inode *first, inode *last) {
+  int num_instructions = 1;
+  for (inode *instruction = first; instruction != last;
+       instruction = instruction->next) {
+    num_instructions++;
   }
 
-  if (SRC2(instruction)) {
-    SRC2(instruction)->cost += freq;
+  inode **originals = zalloc(num_instructions * sizeof(inode *));
+  inode **copies = zalloc(num_instructions * sizeof(inode *));
+  inode *instruction = first;
+  for (int i = 0; i < num_instructions; i++) {
+    if (instruction->op_type == OP_Label) {
+      copies[i] = create_label_instruction();
+    } else {
+      copies[i] = zalloc(sizeof(inode));
+      *copies[i] = *instruction;
+    }
+    if (i > 0) {
+      copies[i - 1]->next = copies[i];
+    }
+    originals[i] = instruction;
+    instruction = instruction->next;
   }
-
-  if (instruction->dest) {
-    instruction->dest->cost += freq;
+  copies[num_instructions - 1]->next = NULL;
+
+  // Jumps to labels within the sequence
+  for (int i = 0; i < num_instructions; i++) {
+    for (int j = 0; copies[i]->jump_to && j < num_instructions; j++) {
+      if (copies[i]->jump_to == originals[j]) {
+        copies[i]->jump_to = copies[j];
+        break;
+      }
+    }
   }
-}
\ No newline at end of file
+
+  inode *copy_head = copies[0];
+  free(originals);
+  free(copies);
+
+  return copy_head;
+}
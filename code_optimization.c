@@ -4,38 +4,94 @@
  */
 
 #include "code_optimization.h"
+#include "block_layout.h"
+#include "control_flow_simplification.h"
 #include "heap.h"
+#include "linear_scan.h"
+#include "live_range_splitting.h"
 #include "liveness_analysis.h"
+#include "loops.h"
+#include "shrink_wrapping.h"
+#include "stack.h"
 
 static bool local_enabled = false;
 static bool global_enabled = false;
 static bool register_allocation_enabled = false;
+static bool linear_scan_enabled = false;
 FILE *file_3addr;
 
 static int NUM_REGISTERS = 16; // $t2 - $t9 + $s0 - $s7. The first 2 $ts are
                                // reserved for temporary operations and arrays.
 
+// Functions with more live ranges than this are allocated by linear scan, as
+// building and coloring the interference graph grows quadratically with them.
+static int MAX_LIVE_RANGES_TO_COLOR = 2000;
+
 static var_list_node *propagated_vars;
 
 // Fast access of a variable via its id.
 // It's filled when the interference graph is created.
 static symtabnode **local_variables;
 
+// Worklists of the graph coloring allocator (iterated register coalescing)
+typedef struct ColoringState {
+  graph *graph;
+  heap *simplify; // Nodes of low degree not related to moves
+  set freeze;     // Nodes of low degree related to moves
+  heap *spill;    // Nodes of high degree
+  set moves; // Ranks of the moves to coalesce. Frequent moves have low ranks.
+  int *moves_by_rank;
+  int *move_ranks;
+  gnode_list_item *stack; // Nodes removed from the graph
+  set marked_nodes;       // Scratch set
+} coloring_state;
+
+// Graph whose moves are being sorted by compare_moves
+static graph *sorting_graph;
+
 static void optimize_locally(inode *instruction_head);
 static void run_peephole_optimization(inode *instruction_head);
 static void do_copy_propagation();
-static void optimize_globally();
+static void find_def_and_use_ids(inode *instruction_head);
+static void optimize_globally(inode *instruction_head);
 static void do_dead_code_elimination();
-static bool remove_dead_instructions();
+static bool remove_dead_instructions(df_problem *liveness,
+                                     set changed_blocks);
 static void print_3addr_instructions(inode *instruction_head);
 static void clear_propagated_vars();
 static void attach_variable_to_original(symtabnode *var, symtabnode *original);
 static void detach_variable_from_original(symtabnode *var);
 static void detach_copies_from_original(symtabnode *original);
 static void optimize_register_allocation(symtabnode *function_header);
-static gnode_list_item *create_interference_graph(symtabnode *function_header);
-static void create_interference_graph_connections(symtabnode *function_header);
-static void color_graph(gnode_list_item *graph, symtabnode *function_header);
+static void find_variable_costs();
+static void find_rematerializable_variables();
+static void add_cost_to_variable(symtabnode *var, long long frequency);
+static graph *create_interference_graph(symtabnode *function_header);
+static void create_interference_graph_connections(graph *graph,
+                                                  symtabnode *function_header,
+                                                  bool add_edges);
+static void color_graph(graph *graph, symtabnode *function_header);
+static void scan_live_ranges(graph *graph, symtabnode *function_header);
+static coloring_state *create_coloring_state(graph *graph);
+static void free_coloring_state(coloring_state *state);
+static int compare_moves(const void *move_id1, const void *move_id2);
+static void simplify_node(coloring_state *state);
+static void coalesce_move(coloring_state *state);
+static void freeze_node(coloring_state *state);
+static void select_potential_spill(coloring_state *state);
+static bool is_move_related(coloring_state *state, gnode *node);
+static void enable_moves(coloring_state *state, gnode *node);
+static void update_worklists(coloring_state *state, gnode *node);
+static void add_to_simplify_worklist(coloring_state *state, gnode *node);
+static bool can_coalesce(coloring_state *state, gnode *node,
+                         gnode *merged_node);
+static void combine_nodes(coloring_state *state, gnode *node,
+                          gnode *merged_node);
+static void freeze_moves(coloring_state *state, gnode *node);
+static void select_registers(gnode_list_item *stack,
+                             symtabnode *function_header);
+static bool is_coalescable_copy(inode *instruction);
+static bool has_lower_spill_cost(gnode *node1, gnode *node2);
 
 void enable_local_optimization() { local_enabled = true; }
 
@@ -45,6 +101,11 @@ void enable_register_allocation_optimization() {
   register_allocation_enabled = true;
 }
 
+void enable_linear_scan_register_allocation() {
+  register_allocation_enabled = true;
+  linear_scan_enabled = true;
+}
+
 void print_blocks_and_instructions(FILE *file) { file_3addr = file; }
 
 void optimize_instructions(symtabnode *function_header, tnode *function_body) {
@@ -56,8 +117,12 @@ void optimize_instructions(symtabnode *function_header, tnode *function_body) {
       fprintf(file_3addr, "\n\nBefore Optimization\n");
       print_3addr_instructions(function_body->code_head);
     }
+    if (global_enabled) {
+      simplify_control_flow_graph(function_body->code_head);
+    }
     optimize_locally(function_body->code_head);
-    optimize_globally();
+    find_def_and_use_ids(function_body->code_head);
+    optimize_globally(function_body->code_head);
     optimize_register_allocation(function_header);
     if (file_3addr) {
       fprintf(file_3addr, "\nAfter Optimization\n");
@@ -127,14 +192,11 @@ void run_peephole_optimization(inode *instruction_head) {
 }
 
 void do_copy_propagation() {
-  blist_node *block_list_node = get_all_blocks();
-  while (block_list_node) {
-    inode *curr_instruction = block_list_node->block->first_instruction;
-
-    while (curr_instruction &&
-           curr_instruction->block == block_list_node->block) {
+  bnode **blocks = get_all_blocks();
+  for (int id = 0; id < get_num_created_blocks(); id++) {
+    bnode *block = blocks[id];
+    FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, block) {
       if (curr_instruction->dead) {
-        curr_instruction = curr_instruction->next;
         continue;
       }
 
@@ -147,7 +209,6 @@ void do_copy_propagation() {
                                    : SRC1(curr_instruction);
         if (root_dest == root_src) {
           curr_instruction->dead = true;
-          curr_instruction = curr_instruction->next;
           continue;
         }
       }
@@ -193,12 +254,9 @@ void do_copy_propagation() {
           SRC2(curr_instruction) = SRC2(curr_instruction)->copied_from;
         }
       }
-
-      curr_instruction = curr_instruction->next;
     }
 
     clear_propagated_vars();
-    block_list_node = block_list_node->next;
   }
 }
 
@@ -237,33 +295,65 @@ void detach_copies_from_original(symtabnode *original) {
   original->copied_to = NULL;
 }
 
-void optimize_globally() {
+/**
+ * Computes the ids of the variables defined and used by each instruction. The
+ * local optimizations rewrite operands, so this must run after them.
+ *
+ * @param instruction_head: first instruction of a function
+ */
+void find_def_and_use_ids(inode *instruction_head) {
+  inode *curr_instruction = instruction_head;
+  while (curr_instruction) {
+    update_def_and_use_ids(curr_instruction);
+    curr_instruction = curr_instruction->next;
+  }
+}
+
+void optimize_globally(inode *instruction_head) {
   if (global_enabled) {
     do_dead_code_elimination();
+    // Dead code elimination may leave blocks and jumps with no effect
+    simplify_control_flow_graph(instruction_head);
+    lay_out_blocks(instruction_head);
   }
 }
 
 void do_dead_code_elimination() {
-  bool any_change = true;
-  while (any_change) {
-    find_in_and_out_liveness_sets(get_all_blocks());
-    any_change = remove_dead_instructions();
+  // Liveness is only recomputed for the blocks affected by the instructions
+  // removed in the previous round.
+  df_problem *liveness = create_liveness_problem();
+  set changed_blocks = create_empty_set(get_num_created_blocks());
+  while (remove_dead_instructions(liveness, changed_blocks)) {
+    update_liveness_problem(liveness, changed_blocks);
+    clear_set(changed_blocks);
   }
+  free_set(changed_blocks);
+  free_dataflow_problem(liveness);
 }
 
-bool remove_dead_instructions() {
-  blist_node *block_list_node = get_all_blocks();
+/**
+ * Marks as dead the instructions that define variables not live after them.
+ *
+ * @param liveness: solved liveness problem
+ * @param changed_blocks: set to add the ids of the blocks with new dead
+ * instructions to
+ *
+ * @return Whether any dead instruction was found.
+ */
+bool remove_dead_instructions(df_problem *liveness, set changed_blocks) {
+  bnode **blocks = get_all_blocks();
   int n = get_total_local_variables();
   bool dead_instructions_found = false;
 
-  while (block_list_node) {
-    set live_instructions = clone_set(block_list_node->block->out);
+  // Scratch set reused by every block
+  set live_instructions = create_empty_set(n);
+
+  for (int id = 0; id < get_num_created_blocks(); id++) {
+    bnode *block = blocks[id];
+    copy_set(live_instructions, liveness->out[block->id]);
 
-    inode *curr_instruction = block_list_node->block->last_instruction;
-    while (curr_instruction &&
-           curr_instruction->block == block_list_node->block) {
+    FOR_EACH_INSTRUCTION_IN_BLOCK_REVERSE(curr_instruction, block) {
       if (curr_instruction->dead) {
-        curr_instruction = curr_instruction->previous;
         continue;
       }
 
@@ -271,54 +361,34 @@ bool remove_dead_instructions() {
           curr_instruction->dest == SRC1(curr_instruction)) {
         // Ignore null assignments
         curr_instruction->dead = true;
-        curr_instruction = curr_instruction->previous;
         continue;
       }
 
-      set lhs_set = create_empty_set(n);
-      set rhs_set = create_empty_set(n);
-
-      if (curr_instruction->dest && curr_instruction->dest->scope == Local) {
-        if (curr_instruction->dest->type == t_Addr) {
-          // In this scenario, we consider that the LHS variable is being used
-          // as it contains the address of the variable that it's effectively
-          // going to change.
-          add_to_set(curr_instruction->dest->id, rhs_set);
-        } else {
-          add_to_set(curr_instruction->dest->id, lhs_set);
-        }
-      }
-
-      if (is_rhs_variable(curr_instruction)) {
-        if (SRC1(curr_instruction) && SRC1(curr_instruction)->scope == Local &&
-            !SRC1(curr_instruction)->is_constant) {
-          add_to_set(SRC1(curr_instruction)->id, rhs_set);
-        }
-
-        if (SRC2(curr_instruction) && SRC2(curr_instruction)->scope == Local &&
-            !SRC2(curr_instruction)->is_constant) {
-          add_to_set(SRC2(curr_instruction)->id, rhs_set);
-        }
-      }
-
       if (redefines_variable(curr_instruction) &&
           curr_instruction->dest->scope == Local) {
         if (!does_elto_belong_to_set(curr_instruction->dest->id,
                                      live_instructions)) {
           curr_instruction->dead = true;
           dead_instructions_found = true;
+          add_to_set(block->id, changed_blocks);
+
+          // The variables used by a dead instruction are not live because of
+          // it, which may let earlier instructions in the block die as well.
+          continue;
         }
       }
 
-      live_instructions = diff_sets(live_instructions, lhs_set);
-      live_instructions = unify_sets(live_instructions, rhs_set);
-
-      curr_instruction = curr_instruction->previous;
+      if (curr_instruction->def_id >= 0) {
+        remove_from_set(curr_instruction->def_id, live_instructions);
+      }
+      for (int i = 0; i < curr_instruction->num_uses; i++) {
+        add_to_set(curr_instruction->use_ids[i], live_instructions);
+      }
     }
-
-    block_list_node = block_list_node->next;
   }
 
+  free_set(live_instructions);
+
   return dead_instructions_found;
 }
 
@@ -350,24 +420,40 @@ void print_3addr_instructions(inode *instruction_head) {
 
 void optimize_register_allocation(symtabnode *function_header) {
   if (register_allocation_enabled && get_total_local_variables() > 0) {
-    gnode_list_item *graph = create_interference_graph(function_header);
-    find_in_and_out_liveness_sets(get_all_blocks());
-    create_interference_graph_connections(function_header);
-    if (file_3addr) {
-      fprintf(file_3addr, "\nInterference Graph:\n\n");
-      fprintf(file_3addr, "\nAdjacency List:\n");
-      print_graph(graph, file_3addr);
+    // Splitting only pays off when coloring, and linear scan is the fast mode
+    // as well as the fallback for functions too large to color
+    if (!linear_scan_enabled &&
+        get_total_local_variables() <= MAX_LIVE_RANGES_TO_COLOR) {
+      split_live_ranges();
+    }
+    find_in_and_out_liveness_sets();
+    find_rematerializable_variables();
+    graph *graph = create_interference_graph(function_header);
+    bool linear_scan =
+        linear_scan_enabled || graph->num_nodes > MAX_LIVE_RANGES_TO_COLOR;
+    create_interference_graph_connections(graph, function_header,
+                                          !linear_scan);
+    if (linear_scan) {
+      scan_live_ranges(graph, function_header);
+    } else {
+      if (file_3addr) {
+        fprintf(file_3addr, "\nInterference Graph:\n\n");
+        fprintf(file_3addr, "\nAdjacency List:\n");
+        print_graph(graph, file_3addr);
+      }
+      color_graph(graph, function_header);
     }
-    color_graph(graph, function_header);
+    place_callee_saved_registers(function_header);
+    free_graph(graph);
     if (file_3addr) {
       fprintf(file_3addr, "\nVariable IDs:\n");
       for (int i = 0; i < get_total_local_variables(); i++) {
         if(local_variables[i]->live_range_node) {
-          fprintf(file_3addr, "%s: [id: %d] [cost: %d] [reg: %d]\n",
+          fprintf(file_3addr, "%s: [id: %d] [cost: %lld] [reg: %d]\n",
                   local_variables[i]->name, (int)local_variables[i]->id,
                   local_variables[i]->cost, local_variables[i]->live_range_node->reg);
         }else {
-          fprintf(file_3addr, "%s: [id: %d] [cost: %d] \n",
+          fprintf(file_3addr, "%s: [id: %d] [cost: %lld] \n",
                   local_variables[i]->name, (int)local_variables[i]->id,
                   local_variables[i]->cost);
         }
@@ -376,32 +462,130 @@ void optimize_register_allocation(symtabnode *function_header) {
   }
 }
 
-gnode_list_item *create_interference_graph(symtabnode *function_header) {
-  gnode_list_item *graph = NULL;
+/**
+ * Estimates the cost of keeping each local variable in memory as the number of
+ * times it is read or written, weighted by the estimated frequency of the
+ * blocks where it happens. Rematerializable variables are never written to
+ * memory, so only their reads count.
+ */
+void find_variable_costs() {
   symtabnode **entries = get_symbol_table_entries(Local);
   int table_size = get_symbol_table_size();
+  for (int i = 0; i < table_size; i++) {
+    for (symtabnode *var = entries[i]; var; var = var->next) {
+      var->cost = 0;
+    }
+  }
+
+  bnode **blocks = get_all_blocks();
+  for (int id = 0; id < get_num_created_blocks(); id++) {
+    bnode *block = blocks[id];
+    long long frequency = estimate_block_frequency(block);
+    FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, block) {
+      if (!curr_instruction->dead && curr_instruction->op_type != OP_Call &&
+          curr_instruction->op_type != OP_Enter &&
+          curr_instruction->op_type != OP_Leave) {
+        add_cost_to_variable(SRC1(curr_instruction), frequency);
+        add_cost_to_variable(SRC2(curr_instruction), frequency);
+        if (curr_instruction->dest &&
+            !curr_instruction->dest->is_rematerializable) {
+          add_cost_to_variable(curr_instruction->dest, frequency);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Finds the variables that can be allocated to a register and whose only
+ * definition assigns them a constant. If they do not get a register, the
+ * constant is loaded at each use instead, and they are never stored. Variables
+ * live at the entry of the function may be read before their definition, so
+ * they are not rematerialized.
+ */
+void find_rematerializable_variables() {
   int n = get_total_local_variables();
+  int *num_definitions = zalloc((n + 1) * sizeof(int));
+  inode **definitions = zalloc((n + 1) * sizeof(inode *));
+  set live_at_entry = create_empty_set(n);
+
+  bnode **blocks = get_all_blocks();
+  for (int id = 0; id < get_num_created_blocks(); id++) {
+    FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, blocks[id]) {
+      if (curr_instruction->dead) {
+        continue;
+      }
+      if (curr_instruction->op_type == OP_Enter) {
+        unify_sets_in_place(live_at_entry, blocks[id]->in);
+      }
+      if (curr_instruction->def_id >= 0) {
+        num_definitions[curr_instruction->def_id]++;
+        definitions[curr_instruction->def_id] = curr_instruction;
+      }
+    }
+  }
+
+  symtabnode **entries = get_symbol_table_entries(Local);
+  for (int i = 0; i < get_symbol_table_size(); i++) {
+    for (symtabnode *var = entries[i]; var; var = var->next) {
+      inode *definition = definitions[var->id];
+      var->is_rematerializable =
+          is_allocation_candidate(var) && !var->formal &&
+          num_definitions[var->id] == 1 &&
+          definition->op_type == OP_Assign && SRC1(definition)->is_constant &&
+          !does_elto_belong_to_set(var->id, live_at_entry);
+      if (var->is_rematerializable) {
+        var->remat_value = SRC1(definition)->const_val;
+        if (var->type == t_Char) {
+          // Chars are stored with sign-extension
+          var->remat_value = ((var->remat_value & 0xff) ^ 0x80) - 0x80;
+        }
+      }
+    }
+  }
+
+  free(num_definitions);
+  free(definitions);
+  free_set(live_at_entry);
+}
+
+/**
+ * Adds the frequency of an instruction to the cost of a local variable it
+ * references.
+ *
+ * @param var: variable referenced by the instruction (possibly NULL)
+ * @param frequency: estimated frequency of the instruction
+ */
+void add_cost_to_variable(symtabnode *var, long long frequency) {
+  if (var && var->scope == Local) {
+    var->cost += frequency;
+  }
+}
+
+graph *create_interference_graph(symtabnode *function_header) {
+  symtabnode **entries = get_symbol_table_entries(Local);
+  int table_size = get_symbol_table_size();
+  int n = get_total_local_variables();
+  graph *graph = create_graph(n);
 
   function_header->entered = true;
   function_header->registers_used = create_empty_set(NUM_REGISTERS);
 
   local_variables = zalloc(n * sizeof(symtabnode *));
+  find_variable_costs();
 
   for (int i = 0; i < table_size; i++) {
     symtabnode *var = entries[i];
     while (var) {
-      if (var->type != t_Array && var->type != t_Addr && !var->formal) {
-        // This optimization is not carried out for arrays
-        var->live_range_node = create_graph_node(var->id, n - 1);
+      if (is_allocation_candidate(var)) {
+        var->live_range_node = create_graph_node(var->id);
         var->live_range_node->cost = var->cost;
         var->live_range_node->regs_to_avoid = create_empty_set(NUM_REGISTERS);
         var->live_range_node->preferential_regs =
             create_full_set(NUM_REGISTERS);
-        graph = add_node_to_graph(var->live_range_node, graph);
-      }
-      if (!var->formal) {
-        local_variables[var->id] = var;
+        add_node_to_graph(var->live_range_node, graph);
       }
+      local_variables[var->id] = var;
       var = var->next;
     }
   }
@@ -409,43 +593,38 @@ gnode_list_item *create_interference_graph(symtabnode *function_header) {
   return graph;
 }
 
-void create_interference_graph_connections(symtabnode *function_header) {
-  blist_node *block_list_node = get_all_blocks();
-  int n = get_total_local_variables();
-
-  while (block_list_node) {
-    set live_now = clone_set(block_list_node->block->out);
-
-    inode *curr_instruction = block_list_node->block->last_instruction;
-    while (curr_instruction &&
-           curr_instruction->block == block_list_node->block) {
+/**
+ * Records the moves and the interferences between the live ranges, along with
+ * the variables live at each call and the registers clobbered by the calls.
+ *
+ * @param graph: interference graph
+ * @param function_header: function entry in the symbol table
+ * @param add_edges: whether to add the edges and moves, which are not needed
+ * by the linear scan
+ */
+void create_interference_graph_connections(graph *graph,
+                                           symtabnode *function_header,
+                                           bool add_edges) {
+  bnode **blocks = get_all_blocks();
+  // Scratch set reused by every block
+  set live_now = create_empty_set(get_total_local_variables());
+
+  for (int id = 0; id < get_num_created_blocks(); id++) {
+    bnode *block = blocks[id];
+    long long frequency = estimate_block_frequency(block);
+    copy_set(live_now, block->out);
+
+    FOR_EACH_INSTRUCTION_IN_BLOCK_REVERSE(curr_instruction, block) {
       if (curr_instruction->dead) {
-        curr_instruction = curr_instruction->previous;
         continue;
       }
 
-      set lhs_set = create_empty_set(n);
-      set rhs_set = create_empty_set(n);
-
-      if (curr_instruction->dest && curr_instruction->dest->scope == Local) {
-        if (curr_instruction->dest->type != t_Addr) {
-          // This optimization is not carried out for arrays
-          add_to_set(curr_instruction->dest->id, lhs_set);
-        }
-      }
-
-      if (is_rhs_variable(curr_instruction)) {
-        if (SRC1(curr_instruction) && SRC1(curr_instruction)->scope == Local &&
-            !SRC1(curr_instruction)->is_constant &&
-            SRC1(curr_instruction)->type != t_Addr) {
-          add_to_set(SRC1(curr_instruction)->id, rhs_set);
-        }
-
-        if (SRC2(curr_instruction) && SRC2(curr_instruction)->scope == Local &&
-            !SRC2(curr_instruction)->is_constant &&
-            SRC2(curr_instruction)->type != t_Addr) {
-          add_to_set(SRC2(curr_instruction)->id, rhs_set);
-        }
+      bool is_copy = is_coalescable_copy(curr_instruction);
+      if (is_copy && add_edges) {
+        // The source and the target of a copy hold the same value, so they do
+        // not interfere because of it and may share a register.
+        add_move(curr_instruction->dest->live_range_node,
+                 SRC1(curr_instruction)->live_range_node, frequency, graph);
       }
 
       if (curr_instruction->op_type == OP_Call &&
@@ -462,45 +641,61 @@ void create_interference_graph_connections(symtabnode *function_header) {
       bool is_call_to_pre_parsed_function =
           curr_instruction->op_type == OP_Call &&
           SRC1(curr_instruction)->entered;
-      if ((!is_set_empty(lhs_set) || is_call_to_pre_parsed_function) &&
+      if ((curr_instruction->def_id >= 0 || is_call_to_pre_parsed_function) &&
           !is_set_empty(live_now)) {
 
         if (is_call_to_pre_parsed_function) {
           // The registers used in the current function must also account for
           // the registers used in the functions called by it
-          function_header->registers_used =
-              unify_sets(function_header->registers_used,
-                         SRC1(curr_instruction)->registers_used);
+          unify_sets_in_place(function_header->registers_used,
+                              SRC1(curr_instruction)->registers_used);
         }
 
         // Link the live_range node of the variable being assigned to to
         // all the variables in the current live set.
-        set tmp_set = clone_set(live_now);
-        for (int i = 0; i < n; i++) {
-          if (does_elto_belong_to_set(i, tmp_set)) {
-            symtabnode *var = get_variable_by_id(i);
-
-            if (var->live_range_node) {
-              if (is_call_to_pre_parsed_function) {
-                // Remove from the preferential registers set of a variable,
-                // the registers used inside the function being called.
-                var->live_range_node->preferential_regs =
-                    diff_sets(var->live_range_node->preferential_regs,
-                              SRC1(curr_instruction)->registers_used);
-              } else {
-                if (curr_instruction->dest != var &&
-                    curr_instruction->dest->live_range_node) {
-                  // No self-loops or multiple edges between the same nodes
-                  add_edge(curr_instruction->dest->live_range_node,
-                           var->live_range_node);
-                }
+        FOR_EACH_ELTO_IN_SET(i, live_now) {
+          symtabnode *var = get_variable_by_id(i);
+
+          if (var->live_range_node) {
+            if (is_call_to_pre_parsed_function) {
+              // Remove from the preferential registers set of a variable,
+              // the registers used inside the function being called.
+              diff_sets_in_place(var->live_range_node->preferential_regs,
+                                 SRC1(curr_instruction)->registers_used);
+            } else if (add_edges) {
+              if (curr_instruction->dest != var &&
+                  curr_instruction->dest->live_range_node &&
+                  !(is_copy && SRC1(curr_instruction) == var)) {
+                // No self-loops or multiple edges between the same nodes
+                add_edge(curr_instruction->dest->live_range_node,
+                         var->live_range_node, graph);
               }
             }
-            remove_from_set(i, tmp_set);
           }
+        }
+      }
 
-          if (is_set_empty(tmp_set))
-            break;
+      if (curr_instruction->op_type == OP_Enter && add_edges) {
+        // The formals in registers are loaded from the stack at the entry of
+        // the function, as if the Enter instruction defined all of them.
+        for (int i = 0; i < get_total_local_variables(); i++) {
+          symtabnode *formal = get_variable_by_id(i);
+          if (!formal->formal || !formal->live_range_node) {
+            continue;
+          }
+          FOR_EACH_ELTO_IN_SET(j, live_now) {
+            if (get_variable_by_id(j)->live_range_node) {
+              add_edge(formal->live_range_node,
+                       get_variable_by_id(j)->live_range_node, graph);
+            }
+          }
+          for (int j = 0; j < i; j++) {
+            if (get_variable_by_id(j)->formal &&
+                get_variable_by_id(j)->live_range_node) {
+              add_edge(formal->live_range_node,
+                       get_variable_by_id(j)->live_range_node, graph);
+            }
+          }
         }
       }
 
@@ -512,135 +707,489 @@ void create_interference_graph_connections(symtabnode *function_header) {
         curr_instruction->live_at_call = clone_set(live_now);
       }
 
-      live_now = diff_sets(live_now, lhs_set);
-      live_now = unify_sets(live_now, rhs_set);
-
-      curr_instruction = curr_instruction->previous;
+      // Variables of type t_Addr do not take part in the allocation
+      if (curr_instruction->def_id >= 0) {
+        remove_from_set(curr_instruction->def_id, live_now);
+      }
+      for (int i = 0; i < curr_instruction->num_value_uses; i++) {
+        add_to_set(curr_instruction->use_ids[i], live_now);
+      }
     }
-
-    block_list_node = block_list_node->next;
   }
+
+  free_set(live_now);
 }
 
 symtabnode *get_variable_by_id(int id) { return local_variables[id]; }
 
-void color_graph(gnode_list_item *graph, symtabnode *function_header) {
+void color_graph(graph *graph, symtabnode *function_header) {
   if (NUM_REGISTERS <= 0) {
     return;
   }
 
   function_header->registers_used = create_empty_set(NUM_REGISTERS);
+  coloring_state *state = create_coloring_state(graph);
+  while (true) {
+    if (state->simplify->size > 0) {
+      simplify_node(state);
+    } else if (!is_set_empty(state->moves)) {
+      coalesce_move(state);
+    } else if (!is_set_empty(state->freeze)) {
+      freeze_node(state);
+    } else if (state->spill->size > 0) {
+      select_potential_spill(state);
+    } else {
+      break;
+    }
+  }
+  select_registers(state->stack, function_header);
 
-  // Construct max heap to find variable to spill more efficiently;
-  // We choose nodes to spill based on the lowest cost and nodes to color
-  // based on the highest cost so that these nodes have a higher change of
-  // getting a register in their preferential list.
-  set nodes_to_spill = create_empty_set(get_total_local_variables());
-  heap *nodes_to_spill_heap =
-      create_empty_heap(get_total_local_variables(), true);
-  heap *nodes_to_color_heap =
-      create_empty_heap(get_total_local_variables(), false);
-  // Store list of nodes in the graph in an array for fast recovery below
-  gnode_list_item *graph_nodes[get_total_local_variables()];
-  gnode_list_item *list_item = graph;
-  while (list_item) {
-    if (list_item->node->num_neighbors < NUM_REGISTERS) {
-      add_to_heap(list_item->node, nodes_to_color_heap);
+  // Coalesced nodes share the register of the node they were merged into
+  for (int id = 0; id < graph->max_nodes; id++) {
+    if (graph->nodes[id] && graph->nodes[id]->alias) {
+      graph->nodes[id]->reg = get_alias(graph->nodes[id])->reg;
+    }
+  }
+  free_coloring_state(state);
+}
+
+/**
+ * Allocates registers to the live ranges by linear scan, trading the quality
+ * of the graph coloring for an allocation time that grows linearly with the
+ * size of the function.
+ *
+ * @param graph: graph with the live ranges, without edges
+ * @param function_header: function entry in the symbol table
+ */
+void scan_live_ranges(graph *graph, symtabnode *function_header) {
+  function_header->registers_used = create_empty_set(NUM_REGISTERS);
+  allocate_registers_by_linear_scan(graph, NUM_REGISTERS);
+  for (int id = 0; id < graph->max_nodes; id++) {
+    if (graph->nodes[id] && graph->nodes[id]->reg >= 0) {
+      add_to_set(graph->nodes[id]->reg, function_header->registers_used);
+    }
+  }
+}
+
+/**
+ * Creates the worklists of the allocator. Nodes with fewer neighbors than
+ * registers can always be colored and go to the simplify worklist, or to the
+ * freeze worklist if they are copy-related. The other nodes are potential
+ * spills. All the moves are candidates to be coalesced.
+ *
+ * @param graph: interference graph
+ *
+ * @return Worklists of the allocator
+ */
+coloring_state *create_coloring_state(graph *graph) {
+  coloring_state *state = zalloc(sizeof(coloring_state));
+  state->graph = graph;
+  // Nodes are simplified cheapest first, so that the most expensive ones are
+  // colored first and have a higher chance of getting a register in their
+  // preferential list.
+  state->simplify = create_empty_heap(graph->max_nodes, has_lower_cost);
+  state->freeze = create_empty_set(graph->max_nodes);
+  state->spill = create_empty_heap(graph->max_nodes, has_lower_spill_cost);
+  state->marked_nodes = create_empty_set(graph->max_nodes);
+
+  for (int id = 0; id < graph->max_nodes; id++) {
+    gnode *node = graph->nodes[id];
+    if (!node) {
+      continue;
+    }
+
+    if (node->degree >= NUM_REGISTERS) {
+      add_to_heap(node, state->spill);
+    } else if (node->num_moves > 0) {
+      add_to_set(node->id, state->freeze);
     } else {
-      add_to_heap(list_item->node, nodes_to_spill_heap);
-      add_to_set(list_item->node->id, nodes_to_spill);
-    }
-    graph_nodes[list_item->node->id] = list_item;
-    list_item = list_item->next;
-  }
-  build_heap(nodes_to_color_heap);
-  build_heap(nodes_to_spill_heap);
-
-  while (graph) {
-    while (nodes_to_color_heap->size > 0) {
-      // Choose node with highest cost
-      gnode *node_to_color = extract_heap_root(nodes_to_color_heap);
-      // Uncomment code below to choose the next node to color with no
-      // assumptions about the cost of a variable
-      // gnode_list_item* node = graph;
-      // while(node && node->node->num_neighbors >= NUM_REGISTERS) {
-      //   node = node->next;
-      // }
-      // node_to_color = node->node;
-      // Ends here
-
-      // Choose register to node
-      set available_regs = create_full_set(NUM_REGISTERS);
-      available_regs = diff_sets(available_regs, node_to_color->regs_to_avoid);
-      if (!is_set_empty(node_to_color->preferential_regs)) {
-        // Choose among a preferential set
-        set tmp =
-            intersect_sets(available_regs, node_to_color->preferential_regs);
-        if (!is_set_empty(tmp)) {
-          // Only if the intersection is not empty, we can to choose a
-          // register in the preferential list
-          available_regs = tmp;
-        }
-      }
-      for (int reg = 0; reg < NUM_REGISTERS; reg++) {
-        if (does_elto_belong_to_set(reg, available_regs)) {
-          node_to_color->reg = reg;
-          break;
-        }
+      add_to_heap(node, state->simplify);
+    }
+  }
+
+  // The most frequent moves are coalesced first
+  int num_moves = graph->num_moves;
+  state->moves = create_full_set(num_moves);
+  state->moves_by_rank = zalloc((num_moves + 1) * sizeof(int));
+  state->move_ranks = zalloc((num_moves + 1) * sizeof(int));
+  for (int id = 0; id < num_moves; id++) {
+    state->moves_by_rank[id] = id;
+  }
+  sorting_graph = graph;
+  qsort(state->moves_by_rank, num_moves, sizeof(int), compare_moves);
+  for (int rank = 0; rank < num_moves; rank++) {
+    state->move_ranks[state->moves_by_rank[rank]] = rank;
+  }
+
+  return state;
+}
+
+/**
+ * Frees the memory allocated to the worklists of the allocator.
+ *
+ * @param state: worklists of the allocator
+ */
+void free_coloring_state(coloring_state *state) {
+  free_heap(state->simplify);
+  free_set(state->freeze);
+  free_heap(state->spill);
+  free_set(state->moves);
+  free_set(state->marked_nodes);
+  free(state->moves_by_rank);
+  free(state->move_ranks);
+  free(state);
+}
+
+/**
+ * Orders moves by decreasing frequency.
+ *
+ * @param move_id1: pointer to the id of a move in sorting_graph
+ * @param move_id2: pointer to the id of another move in sorting_graph
+ *
+ * @return Negative if the first move comes first.
+ */
+int compare_moves(const void *move_id1, const void *move_id2) {
+  int id1 = *(const int *)move_id1;
+  int id2 = *(const int *)move_id2;
+  long long frequency1 = sorting_graph->moves[id1].frequency;
+  long long frequency2 = sorting_graph->moves[id2].frequency;
+  if (frequency1 != frequency2) {
+    return frequency1 > frequency2 ? -1 : 1;
+  }
+  return id1 - id2;
+}
+
+/**
+ * Removes a node of low degree not related to any move from the graph and
+ * pushes it onto the stack.
+ *
+ * @param state: worklists of the allocator
+ */
+void simplify_node(coloring_state *state) {
+  gnode *node = extract_heap_root(state->simplify);
+  remove_node_from_graph(node, state->graph);
+  FOR_EACH_NEIGHBOR(neighbor, node) { update_worklists(state, neighbor); }
+  state->stack = push_to_graph_node_stack(node, state->stack);
+}
+
+/**
+ * Tries to coalesce the most frequent move in the worklist. The nodes of the
+ * move are merged only if that does not make the graph harder to color
+ * (Briggs or George test). Otherwise, the move is set aside until the degree
+ * of a node around it decreases.
+ *
+ * @param state: worklists of the allocator
+ */
+void coalesce_move(coloring_state *state) {
+  int rank = get_next_elto_in_set(0, state->moves);
+  remove_from_set(rank, state->moves);
+  gmove *move = &state->graph->moves[state->moves_by_rank[rank]];
+  gnode *node1 = get_alias(move->node1);
+  gnode *node2 = get_alias(move->node2);
+
+  if (node1 == node2) {
+    move->state = MS_Coalesced;
+    add_to_simplify_worklist(state, node1);
+  } else if (are_nodes_adjacent(node1, node2, state->graph)) {
+    move->state = MS_Constrained;
+    add_to_simplify_worklist(state, node1);
+    add_to_simplify_worklist(state, node2);
+  } else if (can_coalesce(state, node1, node2) ||
+             can_coalesce(state, node2, node1)) {
+    move->state = MS_Coalesced;
+    combine_nodes(state, node1, node2);
+    add_to_simplify_worklist(state, node1);
+  } else {
+    move->state = MS_Active;
+  }
+}
+
+/**
+ * Gives up coalescing the moves of a node of low degree so that it can be
+ * simplified.
+ *
+ * @param state: worklists of the allocator
+ */
+void freeze_node(coloring_state *state) {
+  int id = get_next_elto_in_set(0, state->freeze);
+  gnode *node = state->graph->nodes[id];
+  remove_from_set(id, state->freeze);
+  add_to_heap(node, state->simplify);
+  freeze_moves(state, node);
+}
+
+/**
+ * Chooses the node of high degree with the lowest cost per neighbor to be
+ * simplified. It is only actually spilled if no register is left for it when
+ * the stack is popped (optimistic coloring).
+ *
+ * @param state: worklists of the allocator
+ */
+void select_potential_spill(coloring_state *state) {
+  gnode *node = extract_heap_root(state->spill);
+  add_to_heap(node, state->simplify);
+  freeze_moves(state, node);
+}
+
+/**
+ * Checks whether a node is part of a move that may still be coalesced.
+ *
+ * @param state: worklists of the allocator
+ * @param node: node
+ *
+ * @return
+ */
+bool is_move_related(coloring_state *state, gnode *node) {
+  for (int i = 0; i < node->num_moves; i++) {
+    move_state move_state = state->graph->moves[node->moves[i]].state;
+    if (move_state == MS_Worklist || move_state == MS_Active) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Moves the moves set aside of a node back to the worklist, as the degree of
+ * the node decreased.
+ *
+ * @param state: worklists of the allocator
+ * @param node: node
+ */
+void enable_moves(coloring_state *state, gnode *node) {
+  for (int i = 0; i < node->num_moves; i++) {
+    gmove *move = &state->graph->moves[node->moves[i]];
+    if (move->state == MS_Active) {
+      move->state = MS_Worklist;
+      add_to_set(state->move_ranks[node->moves[i]], state->moves);
+    }
+  }
+}
+
+/**
+ * Moves a node to the right worklist after its degree decreased. A node whose
+ * degree drops below the number of registers stops being a potential spill,
+ * and the moves around it may now be coalesced.
+ *
+ * @param state: worklists of the allocator
+ * @param node: node
+ */
+void update_worklists(coloring_state *state, gnode *node) {
+  if (!does_elto_belong_to_heap(node, state->spill)) {
+    return;
+  }
+
+  if (node->degree >= NUM_REGISTERS) {
+    // Fewer neighbors increase the cost per neighbor
+    increase_heap_key(node, state->spill);
+    return;
+  }
+
+  enable_moves(state, node);
+  FOR_EACH_NEIGHBOR(neighbor, node) { enable_moves(state, neighbor); }
+  remove_from_heap(node, state->spill);
+  if (is_move_related(state, node)) {
+    add_to_set(node->id, state->freeze);
+  } else {
+    add_to_heap(node, state->simplify);
+  }
+}
+
+/**
+ * Moves a node of low degree from the freeze to the simplify worklist once it
+ * is no longer part of any move that may be coalesced.
+ *
+ * @param state: worklists of the allocator
+ * @param node: node
+ */
+void add_to_simplify_worklist(coloring_state *state, gnode *node) {
+  if (does_elto_belong_to_set(node->id, state->freeze) &&
+      node->degree < NUM_REGISTERS && !is_move_related(state, node)) {
+    remove_from_set(node->id, state->freeze);
+    add_to_heap(node, state->simplify);
+  }
+}
+
+/**
+ * Checks whether merging a node into another keeps the graph colorable. By the
+ * George test, it does if every neighbor of the merged node already
+ * interferes with the other node or has low degree. By the Briggs test, it
+ * does if the merged node would have fewer neighbors of high degree than
+ * registers.
+ *
+ * @param state: worklists of the allocator
+ * @param node: node that remains in the graph
+ * @param merged_node: node to be merged
+ *
+ * @return
+ */
+bool can_coalesce(coloring_state *state, gnode *node, gnode *merged_node) {
+  bool george = true;
+  FOR_EACH_NEIGHBOR(neighbor, merged_node) {
+    if (neighbor->degree >= NUM_REGISTERS &&
+        !are_nodes_adjacent(neighbor, node, state->graph)) {
+      george = false;
+      break;
+    }
+  }
+  if (george) {
+    return true;
+  }
+
+  int num_high_degree_neighbors = 0;
+  clear_set(state->marked_nodes);
+  FOR_EACH_NEIGHBOR(neighbor, node) {
+    add_to_set(neighbor->id, state->marked_nodes);
+    if (neighbor->degree >= NUM_REGISTERS) {
+      num_high_degree_neighbors++;
+    }
+  }
+  FOR_EACH_NEIGHBOR(neighbor, merged_node) {
+    if (!does_elto_belong_to_set(neighbor->id, state->marked_nodes) &&
+        neighbor->degree >= NUM_REGISTERS) {
+      num_high_degree_neighbors++;
+    }
+  }
+
+  return num_high_degree_neighbors < NUM_REGISTERS;
+}
+
+/**
+ * Merges the nodes of a move and updates the worklists.
+ *
+ * @param state: worklists of the allocator
+ * @param node: node that remains in the graph
+ * @param merged_node: node merged into the first one
+ */
+void combine_nodes(coloring_state *state, gnode *node, gnode *merged_node) {
+  remove_from_set(merged_node->id, state->freeze);
+  remove_from_heap(merged_node, state->spill);
+
+  merge_nodes(node, merged_node, state->graph);
+  node->cost += merged_node->cost;
+  set preferential_regs =
+      intersect_sets(node->preferential_regs, merged_node->preferential_regs);
+  copy_set(node->preferential_regs, preferential_regs);
+  free_set(preferential_regs);
+
+  // Neighbors already adjacent to both nodes lose one neighbor
+  for (int i = 0; i < merged_node->num_neighbors; i++) {
+    if (!merged_node->neighbors[i]->removed) {
+      update_worklists(state, merged_node->neighbors[i]);
+    }
+  }
+
+  if (does_elto_belong_to_heap(node, state->spill)) {
+    // The cost and the degree of the node changed
+    remove_from_heap(node, state->spill);
+    add_to_heap(node, state->spill);
+  } else if (node->degree >= NUM_REGISTERS) {
+    remove_from_set(node->id, state->freeze);
+    add_to_heap(node, state->spill);
+  }
+}
+
+/**
+ * Gives up coalescing all the moves of a node. The other nodes of these moves
+ * may become ready to be simplified.
+ *
+ * @param state: worklists of the allocator
+ * @param node: node
+ */
+void freeze_moves(coloring_state *state, gnode *node) {
+  for (int i = 0; i < node->num_moves; i++) {
+    int move_id = node->moves[i];
+    gmove *move = &state->graph->moves[move_id];
+    if (move->state != MS_Worklist && move->state != MS_Active) {
+      continue;
+    }
+
+    remove_from_set(state->move_ranks[move_id], state->moves);
+    move->state = MS_Frozen;
+    gnode *other = get_alias(move->node1) == node ? get_alias(move->node2)
+                                                  : get_alias(move->node1);
+    add_to_simplify_worklist(state, other);
+  }
+}
+
+/**
+ * Pops the nodes from the simplify stack, assigning to each one a register not
+ * used by its neighbors popped before it. Nodes for which there is no such
+ * register are spilled.
+ *
+ * @param stack: top of the stack
+ * @param function_header: function whose variables are being allocated
+ */
+void select_registers(gnode_list_item *stack, symtabnode *function_header) {
+  while (stack) {
+    gnode *node = stack->node;
+    stack = pop_from_graph_node_stack(stack);
+
+    // Avoid the registers of the neighbors colored before. A neighbor that was
+    // coalesced has the register of the node it was merged into.
+    for (int i = 0; i < node->num_neighbors; i++) {
+      gnode *neighbor = get_alias(node->neighbors[i]);
+      if (neighbor->reg >= 0) {
+        add_to_set(neighbor->reg, node->regs_to_avoid);
       }
+    }
 
-      // Add used register to the function being processed
-      add_to_set(node_to_color->reg, function_header->registers_used);
-
-      // Add more nodes to be colored and avoid using the same register in the
-      // neighbors of the current node.
-      gnode_list_item *neighbor = node_to_color->neighbors;
-      while (neighbor) {
-        add_to_set(node_to_color->reg, neighbor->node->regs_to_avoid);
-
-        if (neighbor->node->num_neighbors == NUM_REGISTERS) {
-          remove_from_set(neighbor->node->id, nodes_to_spill);
-          add_to_heap(graph_nodes[neighbor->node->id]->node,
-                      nodes_to_color_heap);
-        }
-        neighbor = neighbor->next;
-      }
-
-      graph = remove_node_from_graph(graph_nodes[node_to_color->id], graph);
-      build_heap(nodes_to_color_heap);
-    }
-
-    gnode *node_to_spill = extract_heap_root(nodes_to_spill_heap);
-    while (node_to_spill &&
-           !does_elto_belong_to_set(node_to_spill->id, nodes_to_spill)) {
-      // Nodes can have been removed from the spill set as others were colored.
-      node_to_spill = extract_heap_root(nodes_to_spill_heap);
-    }
-
-    // Uncomment code below to choose the next node to spill with no
-    // assumptions about the cost of a variable
-//    gnode_list_item* node = graph;
-//    while(node && node->node->num_neighbors < NUM_REGISTERS) {
-//      node = node->next;
-//    }
-//    if (node) {
-//      node_to_spill = node->node;
-//    } else {
-//      node_to_spill = NULL;
-//    }
-    // Ends here
-
-    if (node_to_spill) {
-      // As we spill a node, other might be eligible to be colored.
-      gnode_list_item *neighbor = node_to_spill->neighbors;
-      while (neighbor) {
-        if (neighbor->node->num_neighbors == NUM_REGISTERS) {
-          add_to_heap(neighbor->node, nodes_to_color_heap);
-        }
-        neighbor = neighbor->next;
+    // Choose register to node
+    set available_regs = create_full_set(NUM_REGISTERS);
+    diff_sets_in_place(available_regs, node->regs_to_avoid);
+    if (!is_set_empty(node->preferential_regs)) {
+      // Choose among a preferential set
+      set tmp = intersect_sets(available_regs, node->preferential_regs);
+      if (!is_set_empty(tmp)) {
+        // Only if the intersection is not empty, we can to choose a
+        // register in the preferential list
+        copy_set(available_regs, tmp);
       }
+      free_set(tmp);
+    }
+    node->reg = get_next_elto_in_set(0, available_regs);
+    free_set(available_regs);
 
-      graph = remove_node_from_graph(graph_nodes[node_to_spill->id], graph);
+    if (node->reg >= 0) {
+      // Add used register to the function being processed
+      add_to_set(node->reg, function_header->registers_used);
     }
   }
-}
\ No newline at end of file
+}
+
+/**
+ * Checks whether an instruction copies a variable to another that could share
+ * its register. Copies that convert an integer to a character change the
+ * value and must keep the registers apart.
+ *
+ * @param instruction: instruction
+ *
+ * @return
+ */
+bool is_coalescable_copy(inode *instruction) {
+  return instruction->op_type == OP_Assign && instruction->def_id >= 0 &&
+         instruction->dest->live_range_node && SRC1(instruction) &&
+         SRC1(instruction)->live_range_node &&
+         SRC1(instruction) != instruction->dest &&
+         SRC1(instruction)->type == instruction->dest->type;
+}
+
+/**
+ * Orders the candidates to spill by increasing cost per neighbor. A node with
+ * many neighbors frees more registers for the others when spilled.
+ *
+ * @param node1: node1
+ * @param node2: node2
+ *
+ * @return Whether node1 must be spilled before node2.
+ */
+bool has_lower_spill_cost(gnode *node1, gnode *node2) {
+  // Compared as doubles, since the product of a cost and a degree can
+  // overflow a long long
+  double cost1 = (double)node1->cost * node2->degree;
+  double cost2 = (double)node2->cost * node1->degree;
+  if (cost1 != cost2) {
+    return cost1 < cost2;
+  }
+  return node1->id < node2->id;
+}
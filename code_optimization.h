@@ -23,6 +23,11 @@ void enable_global_optimization();
  */
 void enable_register_allocation_optimization();
 
+/**
+ * Enables register allocation by linear scan instead of graph coloring.
+ */
+void enable_linear_scan_register_allocation();
+
 /**
  * Print blocks and instructions.
  *
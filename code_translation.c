@@ -9,6 +9,15 @@
 #include "symbol-table.h"
 
 static int NUM_RESERVED_REG = 2;
+static int NUM_ARGUMENT_REG = 4; // $a0 - $a3
+static bool register_arguments_enabled = false;
+
+// Frame of the function being translated. Leaf functions do not change $sp
+// after the prologue, so they address their frame off $sp and neither save
+// $ra nor set up $fp.
+static bool frame_pointer_omitted = false;
+static int locals_size = 0; // Bytes of the local variables in the frame
+static int frame_size = 0;  // Bytes of the local variables and saved registers
 
 static void print_println();
 static void print_function_header(char *function_name);
@@ -24,8 +33,22 @@ static int find_register(symtabnode *var, int default_reg);
 static void load_reg_allocated_variables_from_memory(inode *instruction);
 static void save_reg_allocated_variables_in_memory(inode *instruction);
 static void reg_to_char(char *reg);
-static void save_registers_at_function_enter(symtabnode *function_ptr);
-static void restore_callee_saved_registers(symtabnode* function_ptr);
+static void save_registers_at_function_enter(symtabnode *function_ptr,
+                                             inode *enter_instruction);
+static void save_callee_saved_registers(symtabnode *function_ptr,
+                                        set registers);
+static void restore_callee_saved_registers(symtabnode* function_ptr,
+                                           set registers);
+static bool are_callee_saved_registers_placed(inode *instruction);
+static void load_formals_to_registers();
+static int count_params(inode *first_param);
+static char *get_argument_register_name(int position);
+static bool is_leaf_function(inode *enter_instruction);
+static bool uses_local_slots(inode *enter_instruction);
+static int get_frame_offset(int fp_offset);
+static char *get_frame_register();
+
+void enable_register_arguments() { register_arguments_enabled = true; }
 
 void print_pre_defined_instructions() {
   print_println();
@@ -35,6 +58,9 @@ void print_pre_defined_instructions() {
 
 void print_instructions(tnode *node) {
   inode *last_instruction = NULL;
+  symtabnode *function_ptr = NULL;
+  int num_params = 0;     // Number of actuals of the next call
+  int param_position = 0; // Position of the actual of the current Param
   inode *curr_instruction = node->code_head;
 
   while (curr_instruction) {
@@ -43,6 +69,18 @@ void print_instructions(tnode *node) {
       continue;
     }
 
+    // Registers saved at the entry of a block are stored after its label.
+    // The ones of the entry block are stored by the Enter instruction.
+    bool saves_registers =
+        are_callee_saved_registers_placed(curr_instruction) &&
+        (!last_instruction ||
+         curr_instruction->block != last_instruction->block) &&
+        curr_instruction->op_type != OP_Enter;
+    if (saves_registers && curr_instruction->op_type != OP_Label) {
+      save_callee_saved_registers(function_ptr,
+                                  curr_instruction->block->saved_registers);
+    }
+
     switch (curr_instruction->op_type) {
     case OP_Global: {
       if (!last_instruction || last_instruction->op_type != OP_Global) {
@@ -86,12 +124,17 @@ void print_instructions(tnode *node) {
         printf("\n.text \n");
       }
 
-      symtabnode *function_ptr = SRC1(curr_instruction);
+      function_ptr = SRC1(curr_instruction);
+      frame_pointer_omitted = is_leaf_function(curr_instruction);
+      // Without calls, no register is saved in the slot of its variable, so
+      // the slots are only needed by the variables kept in memory
+      locals_size = !frame_pointer_omitted || uses_local_slots(curr_instruction)
+                        ? SRC1(curr_instruction)->byte_size
+                        : 0;
       print_function_header(function_ptr->name);
       printf("_%s:              \n", function_ptr->name);
-      save_registers_at_function_enter(function_ptr);
-      printf("  la $fp, 0($sp)  \n");
-      printf("  la $sp, %d($sp) \n", -function_ptr->byte_size);
+      save_registers_at_function_enter(function_ptr, curr_instruction);
+      load_formals_to_registers();
       break;
     }
 
@@ -99,6 +142,12 @@ void print_instructions(tnode *node) {
       printf("\n");
       printf("  # OP_Assign      \n");
 
+      if (curr_instruction->dest->is_rematerializable &&
+          is_var_in_memory(curr_instruction->dest)) {
+        printf("  # > Rematerialized at each use \n");
+        break;
+      }
+
       int src_reg = find_register(SRC1(curr_instruction), 0);
       int dest_reg = find_register(curr_instruction->dest, 0);
       char *src_reg_name = get_register_name(src_reg);
@@ -152,8 +201,24 @@ void print_instructions(tnode *node) {
       printf("\n");
       printf("  # OP_Param       \n");
 
+      if (!last_instruction || last_instruction->op_type != OP_Param) {
+        // Actuals are pushed from the right to the left
+        num_params = count_params(curr_instruction);
+        param_position = num_params - 1;
+      }
+
       int reg = find_register(SRC1(curr_instruction), 0);
       char *reg_name = get_register_name(reg);
+      bool in_argument_reg =
+          register_arguments_enabled && param_position < NUM_ARGUMENT_REG;
+      if (in_argument_reg) {
+        // Load or copy the actual straight to its argument register
+        char *arg_reg_name = get_argument_register_name(param_position);
+        if (!is_var_in_memory(SRC1(curr_instruction))) {
+          copy_from_register(reg_name, arg_reg_name);
+        }
+        reg_name = arg_reg_name;
+      }
 
       if (SRC1(curr_instruction)->formal &&
           SRC1(curr_instruction)->type == t_Array) {
@@ -166,27 +231,38 @@ void print_instructions(tnode *node) {
                            SRC1(curr_instruction)->type);
         }
       }
-      printf("  la $sp, -4($sp)  \n");
-      printf("  sw %s, 0($sp)    \n", reg_name);
+
+      if (!in_argument_reg) {
+        printf("  la $sp, -4($sp)  \n");
+        printf("  sw %s, 0($sp)    \n", reg_name);
+      } else if (param_position == 0) {
+        // The callee may store the actuals passed in registers in the stack,
+        // at the same offsets as if they had been pushed
+        int num_reg_params =
+            num_params < NUM_ARGUMENT_REG ? num_params : NUM_ARGUMENT_REG;
+        printf("  la $sp, %d($sp)  \n", -4 * num_reg_params);
+      }
+      param_position--;
 
       break;
     }
 
     case OP_Call: {
       save_reg_allocated_variables_in_memory(curr_instruction);
-      symtabnode *function_ptr = SRC1(curr_instruction);
+      symtabnode *callee_ptr = SRC1(curr_instruction);
       printf("\n");
       printf("  # OP_Call       \n");
-      printf("  jal _%s         \n", function_ptr->name);
-      printf("  la $sp, %d($sp) \n", 4 * function_ptr->num_formals);
+      printf("  jal _%s         \n", callee_ptr->name);
+      printf("  la $sp, %d($sp) \n", 4 * callee_ptr->num_formals);
       load_reg_allocated_variables_from_memory(curr_instruction);
       break;
     }
 
     case OP_Leave:
+      // The return value is computed after this instruction, so the
+      // callee-saved registers are only restored by the Return instruction.
       printf("\n");
       printf("  # OP_Leave    \n");
-      restore_callee_saved_registers(SRC1(curr_instruction));
       break;
 
     case OP_Return:
@@ -201,10 +277,20 @@ void print_instructions(tnode *node) {
           copy_from_register(get_register_name(reg), "$v0");
         }
       }
-      printf("  la $sp, 0($fp) \n");
-      printf("  lw $ra, 0($sp) \n");
-      printf("  lw $fp, 4($sp) \n");
-      printf("  la $sp, 8($sp) \n");
+      restore_callee_saved_registers(
+          function_ptr, are_callee_saved_registers_placed(curr_instruction)
+                            ? curr_instruction->block->restored_registers
+                            : function_ptr->registers_used);
+      if (frame_pointer_omitted) {
+        if (frame_size > 0) {
+          printf("  la $sp, %d($sp) \n", frame_size);
+        }
+      } else {
+        printf("  la $sp, 0($fp) \n");
+        printf("  lw $ra, 0($sp) \n");
+        printf("  lw $fp, 4($sp) \n");
+        printf("  la $sp, 8($sp) \n");
+      }
       printf("  jr $ra         \n");
       break;
 
@@ -354,6 +440,11 @@ void print_instructions(tnode *node) {
       break;
     }
 
+    if (saves_registers && curr_instruction->op_type == OP_Label) {
+      save_callee_saved_registers(function_ptr,
+                                  curr_instruction->block->saved_registers);
+    }
+
     last_instruction = curr_instruction;
     curr_instruction = curr_instruction->next;
   }
@@ -371,7 +462,9 @@ void print_println() {
   printf(".text               \n");
   printf("_println:           \n");
   printf("  li $v0, 1         \n");
-  printf("  lw $a0, 0($sp)    \n");
+  if (!register_arguments_enabled) {
+    printf("  lw $a0, 0($sp)    \n");
+  }
   printf("  syscall           \n");
   printf("  li $v0, 4         \n");
   printf("  la $a0, nl        \n");
@@ -411,17 +504,25 @@ void load_int_to_register(int integer, char *reg) {
 void load_from_memory(symtabnode *addr, char *reg, int dest_type) {
   if (addr->is_constant) {
     load_int_to_register(addr->const_val, reg);
+  } else if (addr->is_rematerializable) {
+    load_int_to_register(addr->remat_value, reg);
   } else {
     char load_op_type = get_mem_op_type(dest_type);
     if (addr->scope == Global) {
       printf("  l%c %s, _%s \n", load_op_type, reg, addr->name);
     } else {
-      printf("  l%c %s, %d($fp) \n", load_op_type, reg, addr->fp_offset);
+      printf("  l%c %s, %d(%s) \n", load_op_type, reg,
+             get_frame_offset(addr->fp_offset), get_frame_register());
     }
   }
 }
 
 void store_at_memory(symtabnode *addr, char *reg) {
+  if (addr->is_rematerializable) {
+    // Its value is always the same constant, which is loaded again when needed
+    return;
+  }
+
   char mem_op_type;
   if (addr->type == t_Addr) {
     mem_op_type = get_mem_op_type(t_Word);
@@ -432,7 +533,8 @@ void store_at_memory(symtabnode *addr, char *reg) {
   if (addr->scope == Global) {
     printf("  s%c %s, _%s \n", mem_op_type, reg, addr->name);
   } else {
-    printf("  s%c %s, %d($fp) \n", mem_op_type, reg, addr->fp_offset);
+    printf("  s%c %s, %d(%s) \n", mem_op_type, reg,
+           get_frame_offset(addr->fp_offset), get_frame_register());
   }
 }
 
@@ -532,25 +634,19 @@ void load_reg_allocated_variables_from_memory(inode *instruction) {
       printf("\n  # Load registers \n");
       some_load = false;
     }
-    set tmp = clone_set(instruction->live_at_call);
-    int i = 0;
-    while (!is_set_empty(tmp)) {
-      if (does_elto_belong_to_set(i, tmp)) {
-        symtabnode *var = get_variable_by_id(i);
-        if (!is_var_in_memory(var)) {
-          if (!SRC1(instruction)->entered ||
-              does_elto_belong_to_set(var->live_range_node->reg,
-                                      SRC1(instruction)->registers_used)) {
-            if(var->live_range_node->reg < 8) { // One of the $t registers
-              int reg = find_register(var, 0);
-              load_from_memory(var, get_register_name(reg), var->type);
-              some_load = true;
-            }
+    FOR_EACH_ELTO_IN_SET(i, instruction->live_at_call) {
+      symtabnode *var = get_variable_by_id(i);
+      if (!is_var_in_memory(var)) {
+        if (!SRC1(instruction)->entered ||
+            does_elto_belong_to_set(var->live_range_node->reg,
+                                    SRC1(instruction)->registers_used)) {
+          if(var->live_range_node->reg < 8) { // One of the $t registers
+            int reg = find_register(var, 0);
+            load_from_memory(var, get_register_name(reg), var->type);
+            some_load = true;
           }
         }
-        remove_from_set(i, tmp);
       }
-      i = i + 1;
     }
     if (!some_load) {
       printf("  # > Nothing to load \n");
@@ -569,28 +665,22 @@ void save_reg_allocated_variables_in_memory(inode *instruction) {
       printf("\n  # Store registers \n");
       some_storage = false;
     }
-    set tmp = clone_set(instruction->live_at_call);
-    int i = 0;
-    while (!is_set_empty(tmp)) {
-      if (does_elto_belong_to_set(i, tmp)) {
-        symtabnode *var = get_variable_by_id(i);
-        if (!is_var_in_memory(var)) {
-          if (!SRC1(instruction)->entered ||
-              does_elto_belong_to_set(var->live_range_node->reg,
-                                      SRC1(instruction)->registers_used)) {
-            if(var->live_range_node->reg < 8) { // One of the $t registers
-              // We only save to memory if the register where the variable is
-              // allocated is used inside the function being called or if the
-              // function has not been parsed yet.
-              int reg = find_register(var, 0);
-              store_at_memory(var, get_register_name(reg));
-              some_storage = true;
-            }
+    FOR_EACH_ELTO_IN_SET(i, instruction->live_at_call) {
+      symtabnode *var = get_variable_by_id(i);
+      if (!is_var_in_memory(var)) {
+        if (!SRC1(instruction)->entered ||
+            does_elto_belong_to_set(var->live_range_node->reg,
+                                    SRC1(instruction)->registers_used)) {
+          if(var->live_range_node->reg < 8) { // One of the $t registers
+            // We only save to memory if the register where the variable is
+            // allocated is used inside the function being called or if the
+            // function has not been parsed yet.
+            int reg = find_register(var, 0);
+            store_at_memory(var, get_register_name(reg));
+            some_storage = true;
           }
         }
-        remove_from_set(i, tmp);
       }
-      i = i + 1;
     }
     if (!some_storage) {
       printf("  # > Nothing to store \n");
@@ -604,7 +694,20 @@ void reg_to_char(char *reg) {
   printf("  sra %s, %s, 24 \n", reg, reg);
 }
 
-void save_registers_at_function_enter(symtabnode *function_ptr) {
+/**
+ * Sets up the frame of a function and saves the callee-saved registers to be
+ * saved at its entry. The frame pointer points to the saved return address,
+ * with the old frame pointer and the actuals above it, and the local
+ * variables and the slots of all the callee-saved registers below it, so the
+ * offsets of the formals do not depend on the number of registers saved. Leaf
+ * functions only move $sp below the local variables and the callee-saved
+ * registers, if any.
+ *
+ * @param function_ptr: function entry in the symbol table
+ * @param enter_instruction: Enter instruction of the function
+ */
+void save_registers_at_function_enter(symtabnode *function_ptr,
+                                      inode *enter_instruction) {
   int num_callee_saved_registers = 0;
 
   // s0 - s7
@@ -613,39 +716,216 @@ void save_registers_at_function_enter(symtabnode *function_ptr) {
       num_callee_saved_registers++;
     }
   }
-  // fp + ra + callee-saved
-  int bytes_in_memory = 8 + 4 * num_callee_saved_registers;
-  printf("  la $sp, -%d($sp) \n", bytes_in_memory);
+  frame_size = locals_size + 4 * num_callee_saved_registers;
+  if (frame_pointer_omitted) {
+    if (frame_size > 0) {
+      printf("  la $sp, %d($sp) \n", -frame_size);
+    }
+  } else {
+    printf("  la $sp, -8($sp) \n");
+    printf("  sw $fp, 4($sp)  \n");
+    printf("  sw $ra, 0($sp)  \n");
+    printf("  la $fp, 0($sp)  \n");
+    printf("  la $sp, %d($sp) \n", -frame_size);
+  }
+
+  save_callee_saved_registers(
+      function_ptr, are_callee_saved_registers_placed(enter_instruction)
+                        ? enter_instruction->block->saved_registers
+                        : function_ptr->registers_used);
+}
 
-  // Store registers in memory
-  int pos = 0;
+/**
+ * Stores callee-saved registers in their slots, right below the local
+ * variables.
+ *
+ * @param function_ptr: function entry in the symbol table
+ * @param registers: registers to store
+ */
+void save_callee_saved_registers(symtabnode *function_ptr, set registers) {
+  int pos = -locals_size;
   for(int reg = 8; reg < function_ptr->registers_used.max_size; reg++) {
     if(does_elto_belong_to_set(reg, function_ptr->registers_used)) {
-      char* reg_name = get_register_name(reg + 2); // Index starts in $t2
-      printf("  sw %s, %d($sp)  \n", reg_name, pos);
-      pos += 4;
+      pos -= 4;
+      if (does_elto_belong_to_set(reg, registers)) {
+        char* reg_name = get_register_name(reg + 2); // Index starts in $t2
+        printf("  sw %s, %d(%s)  \n", reg_name, get_frame_offset(pos),
+               get_frame_register());
+      }
     }
   }
-  printf("  sw $fp, %d($sp)  \n", pos + 4);
-  printf("  sw $ra, %d($sp)  \n", pos);
 }
 
-void restore_callee_saved_registers(symtabnode* function_ptr) {
-  int pos = 0;
+/**
+ * Restores callee-saved registers from their slots.
+ *
+ * @param function_ptr: function entry in the symbol table
+ * @param registers: registers to restore
+ */
+void restore_callee_saved_registers(symtabnode* function_ptr, set registers) {
+  int pos = -locals_size;
   for(int reg = 8; reg < function_ptr->registers_used.max_size; reg++) {
     if(does_elto_belong_to_set(reg, function_ptr->registers_used)) {
-      char* reg_name = get_register_name(reg + 2); // Index starts in $t2
-      if (pos == 0) {
-        printf("  la $sp, 0($fp)  \n");
+      pos -= 4;
+      if (does_elto_belong_to_set(reg, registers)) {
+        char* reg_name = get_register_name(reg + 2); // Index starts in $t2
+        printf("  lw %s, %d(%s)  \n", reg_name, get_frame_offset(pos),
+               get_frame_register());
       }
-      printf("  lw %s, %d($sp)  \n", reg_name, pos);
-      pos += 4;
     }
   }
-  if (pos > 0) {
-    // Move the frame pointer to where the return register is in the stack
-    printf("  la $fp, %d($fp) \n", pos);
-  } else {
-    printf("#  No callee-saved registers to restore");
+}
+
+/**
+ * Checks whether the places where the callee-saved registers are saved and
+ * restored were chosen for the block of an instruction. Otherwise, they are
+ * all saved at the entry of the function and restored by every Return.
+ *
+ * @param instruction: instruction
+ *
+ * @return
+ */
+bool are_callee_saved_registers_placed(inode *instruction) {
+  return instruction->block &&
+         !is_set_undefined(instruction->block->saved_registers);
+}
+
+/**
+ * Loads the formals allocated to registers from their stack slots, which are
+ * still used when they are spilled. Formals passed in argument registers are
+ * copied to their registers or stored in their stack slots instead.
+ */
+void load_formals_to_registers() {
+  symtabnode **entries = get_symbol_table_entries(Local);
+  for (int i = 0; i < get_symbol_table_size(); i++) {
+    for (symtabnode *var = entries[i]; var; var = var->next) {
+      if (!var->formal) {
+        continue;
+      }
+
+      // The first formal is right above the saved $ra and $fp
+      int position = var->fp_offset / 4 - 2;
+      if (register_arguments_enabled && position < NUM_ARGUMENT_REG) {
+        char *arg_reg_name = get_argument_register_name(position);
+        if (is_var_in_memory(var)) {
+          printf("  sw %s, %d(%s)  \n", arg_reg_name,
+                 get_frame_offset(var->fp_offset), get_frame_register());
+        } else {
+          char *reg_name = get_register_name(find_register(var, 0));
+          copy_from_register(arg_reg_name, reg_name);
+          if (var->type == t_Char) {
+            // The actual may be an integer
+            reg_to_char(reg_name);
+          }
+        }
+      } else if (!is_var_in_memory(var)) {
+        int reg = find_register(var, 0);
+        load_from_memory(var, get_register_name(reg), var->type);
+      }
+    }
+  }
+}
+
+/**
+ * Counts the consecutive Param instructions of a call.
+ *
+ * @param first_param: first Param instruction of the call
+ *
+ * @return Number of actuals of the call
+ */
+int count_params(inode *first_param) {
+  int num_params = 0;
+  for (inode *instruction = first_param; instruction;
+       instruction = instruction->next) {
+    if (instruction->dead) {
+      continue;
+    }
+    if (instruction->op_type != OP_Param) {
+      break;
+    }
+    num_params++;
   }
+  return num_params;
 }
+
+/**
+ * Gets the name of the register where an actual is passed.
+ *
+ * @param position: position of the actual in the call (less than 4)
+ *
+ * @return Name of the register
+ */
+char *get_argument_register_name(int position) {
+  char *name = zalloc(4 * sizeof(char));
+  sprintf(name, "$a%d", position);
+  return name;
+}
+
+/**
+ * Checks whether a function calls no other function.
+ *
+ * @param enter_instruction: Enter instruction of the function
+ *
+ * @return
+ */
+bool is_leaf_function(inode *enter_instruction) {
+  for (inode *instruction = enter_instruction; instruction;
+       instruction = instruction->next) {
+    if (!instruction->dead && instruction->op_type == OP_Call) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks whether a function reads or writes a local variable, other than a
+ * formal, in its stack slot.
+ *
+ * @param enter_instruction: Enter instruction of the function
+ *
+ * @return
+ */
+bool uses_local_slots(inode *enter_instruction) {
+  for (inode *instruction = enter_instruction; instruction;
+       instruction = instruction->next) {
+    if (instruction->dead || instruction->op_type == OP_Enter ||
+        instruction->op_type == OP_Leave || instruction->op_type == OP_Label ||
+        instruction->op_type == OP_Goto) {
+      continue;
+    }
+    symtabnode *vars[3] = {SRC1(instruction), SRC2(instruction),
+                           instruction->dest};
+    for (int i = 0; i < 3; i++) {
+      if (vars[i] && vars[i]->scope == Local && !vars[i]->is_constant &&
+          !vars[i]->formal && is_var_in_memory(vars[i])) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * Converts an offset relative to the frame pointer to an offset relative to
+ * the register used to address the frame of the current function. Formals
+ * have positive offsets and sit right above the saved $ra and $fp, which are
+ * not in the frame of leaf functions.
+ *
+ * @param fp_offset: offset relative to the frame pointer
+ *
+ * @return Offset
+ */
+int get_frame_offset(int fp_offset) {
+  if (!frame_pointer_omitted) {
+    return fp_offset;
+  }
+  return fp_offset > 0 ? frame_size + fp_offset - 8 : frame_size + fp_offset;
+}
+
+/**
+ * Gets the register used to address the frame of the current function.
+ *
+ * @return Name of the register
+ */
+char *get_frame_register() { return frame_pointer_omitted ? "$sp" : "$fp"; }
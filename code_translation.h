@@ -10,6 +10,12 @@
 #include "protos.h"
 #include "syntax-tree.h"
 
+/**
+ * Enables the register calling convention: the first actuals of a call are
+ * passed in $a0 - $a3 instead of the stack.
+ */
+void enable_register_arguments();
+
 /**
  * Prints code for pre-defined functions.
  */
@@ -3,21 +3,39 @@
  * CSC 553 (Spring 2021)
  */
 
-#include "control_flow.h"
+#include "loops.h"
 
 static int total_instructions = 0;
 static int total_assignment_instructions = 0;
+static int num_blocks = 0;
+static int num_reachable_blocks = 0;
+static bnode **blocks_in_rpo = NULL;
 
 static void find_block_leaders(inode *instruction_head);
 static void update_blocks(inode *instruction_head);
+static void find_reverse_postorder();
+static int add_blocks_in_postorder(bnode *root, bool *visited, bnode **stack,
+                                   int *next_child, bnode **postorder,
+                                   int num_visited);
 static void find_dominators();
-static set get_dominators_from_predecessors(bnode *block);
+static int intersect_dominators(int *idom, int block1, int block2);
+static void number_dominator_tree();
 
 void build_control_flow_graph(inode *instruction_head) {
   clear_created_blocks();
+  total_instructions = 0;
+  total_assignment_instructions = 0;
+  for (inode *instruction = instruction_head; instruction;
+       instruction = instruction->next) {
+    instruction->block = NULL;
+  }
+
   find_block_leaders(instruction_head);
   update_blocks(instruction_head);
+  compress_block_edges();
+  find_reverse_postorder();
   find_dominators();
+  find_loops();
 }
 
 /**
@@ -55,6 +73,11 @@ void find_block_leaders(inode *instruction_head) {
 
     case OP_If:
     case OP_Goto:
+      if (curr_instruction->dead) {
+        // Jumps removed by the optimizations do not split blocks
+        break;
+      }
+
       // Destiny of the jump starts a new block
       if (!curr_instruction->jump_to->block) {
         curr_instruction->jump_to->block =
@@ -73,6 +96,16 @@ void find_block_leaders(inode *instruction_head) {
         }
       }
       break;
+    case OP_Return:
+      // Instructions after a return can only be reached by a jump
+      if (!curr_instruction->dead && curr_instruction->next &&
+          !curr_instruction->next->block) {
+        curr_instruction->next->block =
+            create_block(curr_instruction->next, true);
+        curr_instruction->next->block->first_instruction =
+            curr_instruction->next;
+      }
+      break;
     default:
       break;
     }
@@ -83,146 +116,339 @@ void find_block_leaders(inode *instruction_head) {
 
 /**
  * Update each instruction with the blocks they belong to, connections
- * between subsequent blocks, and blocks' last instructions.
+ * between subsequent blocks, and blocks' last instructions. Dead instructions
+ * belong to blocks but do not create connections.
  *
  * @param instruction_head: first instruction of a function
  */
 void update_blocks(inode *instruction_head) {
-  inode *curr_instruction = instruction_head;
+  bnode *curr_block = NULL;
+  inode *last_live_instruction = NULL; // In the current block
 
-  if (curr_instruction) {
-    bnode *curr_block = curr_instruction->block;
-    curr_instruction = curr_instruction->next;
+  for (inode *curr_instruction = instruction_head; curr_instruction;
+       curr_instruction = curr_instruction->next) {
+    if (curr_instruction->op_type == OP_Global) {
+      // Ignore Global variables declaration
+      continue;
+    }
 
-    while (curr_instruction) {
-      if(curr_instruction->op_type == OP_Global) {
-        // Ignore Global variables declaration
-        curr_instruction = curr_instruction->next;
-        continue;
+    if (!curr_instruction->block) {
+      curr_instruction->block = curr_block;
+    } else if (curr_instruction->block != curr_block) {
+      // This instruction is the leader of another block. We don't connect the
+      // previous block to it if the previous block never falls through, nor
+      // if it ends with a jump to this block, as this was already handled by
+      // the jump.
+      bool falls_through =
+          !last_live_instruction ||
+          (last_live_instruction->op_type != OP_Goto &&
+           last_live_instruction->op_type != OP_Return &&
+           !(last_live_instruction->op_type == OP_If &&
+             last_live_instruction->jump_to->block ==
+                 curr_instruction->block));
+      if (curr_block && falls_through) {
+        connect_blocks(curr_block, curr_instruction->block);
       }
+      curr_block = curr_instruction->block;
+      last_live_instruction = NULL;
+    }
 
-      if (!curr_instruction->block) {
-        curr_instruction->block = curr_block;
-      } else {
-        // This instruction is the leader of another block. Save this block
-        // to propagate further.
-        if (curr_instruction->previous &&
-            curr_instruction->previous->jump_to != curr_instruction) {
-          // We don'' connect if the previous instruction was a jump to the
-          // current one as this was already handled by the previous
-          // instruction.
-          if(curr_instruction->previous->block) {
-            connect_blocks(curr_instruction->previous->block,
-                           curr_instruction->block);
-          }
-        }
-        curr_block = curr_instruction->block;
-      }
+    // When we switch to a new block, this will have the last instruction
+    // of the previous block.
+    curr_block->last_instruction = curr_instruction;
 
-      // When we switch to a new block, this will have the last instruction
-      // of the previous block.
-      curr_block->last_instruction = curr_instruction;
+    if (curr_instruction->dead) {
+      continue;
+    }
+    last_live_instruction = curr_instruction;
 
-      // Add the instruction this one jumps to as a child of the current
-      // instruction's block
-      if (curr_instruction->op_type == OP_If ||
-          curr_instruction->op_type == OP_Goto) {
-        connect_blocks(curr_block, curr_instruction->jump_to->block);
-      }
+    // Add the instruction this one jumps to as a child of the current
+    // instruction's block
+    if (curr_instruction->op_type == OP_If ||
+        curr_instruction->op_type == OP_Goto) {
+      connect_blocks(curr_block, curr_instruction->jump_to->block);
+    }
+  }
+}
 
-      curr_instruction = curr_instruction->next;
+/**
+ * Numbers the blocks in reverse postorder of a depth-first traversal of the
+ * control flow graph, starting from the entry block. Blocks unreachable from
+ * the entry are numbered after the reachable ones.
+ */
+void find_reverse_postorder() {
+  num_blocks = get_num_created_blocks();
+  bnode **blocks = get_all_blocks();
+  bnode *entry = NULL;
+  for (int i = 0; i < num_blocks; i++) {
+    if (blocks[i]->first_instruction->op_type == OP_Enter) {
+      entry = blocks[i];
+    }
+  }
+
+  free(blocks_in_rpo);
+  blocks_in_rpo = NULL;
+  if (num_blocks == 0) {
+    return;
+  }
+
+  blocks_in_rpo = zalloc(num_blocks * sizeof(bnode *));
+  bool *visited = zalloc(num_blocks * sizeof(bool));
+  bnode **stack = zalloc(num_blocks * sizeof(bnode *));
+  int *next_child = zalloc(num_blocks * sizeof(int));
+  bnode **postorder = zalloc(num_blocks * sizeof(bnode *));
+
+  int num_reachable = 0;
+  if (entry) {
+    num_reachable = add_blocks_in_postorder(entry, visited, stack, next_child,
+                                            postorder, 0);
+  }
+  int num_visited = num_reachable;
+  for (int i = 0; i < num_blocks; i++) {
+    if (!visited[i]) {
+      num_visited = add_blocks_in_postorder(blocks[i], visited, stack,
+                                            next_child, postorder, num_visited);
     }
   }
+
+  // Reverse each of the two parts so that the reachable blocks come first
+  for (int i = 0; i < num_reachable; i++) {
+    blocks_in_rpo[i] = postorder[num_reachable - 1 - i];
+  }
+  for (int i = num_reachable; i < num_blocks; i++) {
+    blocks_in_rpo[i] = postorder[num_blocks - 1 - (i - num_reachable)];
+  }
+  for (int i = 0; i < num_blocks; i++) {
+    blocks_in_rpo[i]->rpo_number = i;
+  }
+  num_reachable_blocks = num_reachable;
+
+  free(visited);
+  free(stack);
+  free(next_child);
+  free(postorder);
 }
 
-void find_dominators() {
-  int n = get_num_created_blocks();
-  set universe_set = create_full_set(n);
-
-  // Initialization
-  blist_node *block_list_head = get_all_blocks();
-  blist_node *block_list_node = block_list_head;
-  while (block_list_node) {
-    if (!block_list_node->block->parents) {
-      set root_set = create_empty_set(n);
-      add_to_set(block_list_node->block->id, root_set);
-      block_list_node->block->dominators = root_set;
+/**
+ * Appends to a list the blocks reachable from a root that were not visited
+ * yet, in postorder. The traversal uses an explicit stack so that large
+ * functions do not overflow the call stack.
+ *
+ * @param root: block to start the traversal from
+ * @param visited: visited flag per block id
+ * @param stack: scratch stack of blocks
+ * @param next_child: scratch index of the next successor to visit per stack
+ * position
+ * @param postorder: list of blocks in postorder
+ * @param num_visited: number of blocks already in the postorder list
+ *
+ * @return Number of blocks in the postorder list after the traversal.
+ */
+int add_blocks_in_postorder(bnode *root, bool *visited, bnode **stack,
+                            int *next_child, bnode **postorder,
+                            int num_visited) {
+  int top = 0;
+  stack[0] = root;
+  next_child[0] = 0;
+  visited[root->id] = true;
+
+  while (top >= 0) {
+    bnode *block = stack[top];
+    if (next_child[top] < block->num_successors) {
+      bnode *child = block->successors[next_child[top]++];
+      if (!visited[child->id]) {
+        visited[child->id] = true;
+        top++;
+        stack[top] = child;
+        next_child[top] = 0;
+      }
     } else {
-      block_list_node->block->dominators = universe_set;
+      postorder[num_visited++] = stack[top];
+      top--;
     }
+  }
+
+  return num_visited;
+}
 
-    block_list_node = block_list_node->next;
+void find_dominators() {
+  if (num_blocks == 0) {
+    return;
+  }
+
+  // Cooper, Harvey and Kennedy's algorithm over the positions of the blocks in
+  // reverse postorder. The entry and the blocks of unreachable regions that
+  // have no predecessors visited before them are children of a virtual root,
+  // represented by position -1.
+  int *idom = zalloc(num_blocks * sizeof(int));
+  bool *is_root = zalloc(num_blocks * sizeof(bool));
+  for (int i = 0; i < num_blocks; i++) {
+    idom[i] = -2; // Undefined
+  }
+  for (int i = 0; i < num_blocks; i++) {
+    bnode *block = blocks_in_rpo[i];
+    bool has_visited_parent = false;
+    for (int j = 0; j < block->num_predecessors; j++) {
+      if (block->predecessors[j]->rpo_number < i) {
+        has_visited_parent = true;
+      }
+    }
+    bool is_entry = block->first_instruction->op_type == OP_Enter;
+    if (is_entry || !has_visited_parent) {
+      is_root[i] = true;
+      idom[i] = -1;
+    }
   }
 
-  // Update dominators until convergence
-  bool converged = false;
-  while (!converged) {
-    block_list_node = block_list_head;
-    converged = true;
-    while (block_list_node && block_list_node->block->parents) {
-      set block_set = create_empty_set(n);
-      add_to_set(block_list_node->block->id, block_set);
-      set new_set = unify_sets(
-          block_set, get_dominators_from_predecessors(block_list_node->block));
-      if (!are_set_equals(block_list_node->block->dominators, new_set)) {
-        block_list_node->block->dominators = new_set;
-        converged = false;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = 0; i < num_blocks; i++) {
+      if (is_root[i]) {
+        continue;
       }
 
-      block_list_node = block_list_node->next;
+      // Unreachable predecessors do not affect the dominators of reachable
+      // blocks
+      bool is_reachable = i < num_reachable_blocks;
+      int new_idom = -2;
+      bnode *block = blocks_in_rpo[i];
+      for (int j = 0; j < block->num_predecessors; j++) {
+        int p = block->predecessors[j]->rpo_number;
+        if (idom[p] != -2 && (!is_reachable || p < num_reachable_blocks)) {
+          new_idom =
+              new_idom == -2 ? p : intersect_dominators(idom, p, new_idom);
+        }
+      }
+      if (idom[i] != new_idom) {
+        idom[i] = new_idom;
+        changed = true;
+      }
     }
   }
+
+  for (int i = 0; i < num_blocks; i++) {
+    blocks_in_rpo[i]->dominated = NULL;
+  }
+  for (int i = num_blocks - 1; i >= 0; i--) {
+    bnode *block = blocks_in_rpo[i];
+    if (idom[i] >= 0) {
+      block->idom = blocks_in_rpo[idom[i]];
+      blist_node *dominated_node = zalloc(sizeof(blist_node));
+      dominated_node->block = block;
+      dominated_node->next = block->idom->dominated;
+      block->idom->dominated = dominated_node;
+    } else {
+      block->idom = NULL;
+    }
+  }
+
+  number_dominator_tree();
+
+  free(idom);
+  free(is_root);
 }
 
 /**
- * Finds the set comprised by the intersection of dominators of the
- * predecessors of a block.
+ * Finds the closest common ancestor of two blocks in the dominator tree being
+ * built.
  *
- * @param block: block
+ * @param idom: position of the immediate dominator of each block
+ * @param block1: position of a block in reverse postorder
+ * @param block2: position of another block in reverse postorder
  *
- * @return Set formed by the intersection of the dominators from all the
- * predecessors of a block.
+ * @return Position of the common dominator or -1 for the virtual root.
  */
-set get_dominators_from_predecessors(bnode *block) {
-  if (!block->parents) {
-    // Empty set if no predecessors
-    return create_empty_set(block->dominators.max_size);
+int intersect_dominators(int *idom, int block1, int block2) {
+  while (block1 != block2) {
+    while (block1 > block2) {
+      block1 = idom[block1];
+    }
+    while (block2 > block1) {
+      block2 = idom[block2];
+    }
   }
+  return block1;
+}
 
-  blist_node *parent = block->parents;
-  set set = parent->block->dominators;
-  parent = parent->next;
-  while (parent) {
-    set = intersect_sets(set, parent->block->dominators);
-    parent = parent->next;
+/**
+ * Numbers the blocks in preorder and postorder of a depth-first traversal of
+ * the dominator tree, so that dominance can be checked in constant time.
+ */
+void number_dominator_tree() {
+  bnode **stack = zalloc(num_blocks * sizeof(bnode *));
+  blist_node **next_child = zalloc(num_blocks * sizeof(blist_node *));
+  int pre_number = 0;
+  int post_number = 0;
+
+  for (int i = 0; i < num_blocks; i++) {
+    if (blocks_in_rpo[i]->idom) {
+      continue;
+    }
+
+    int top = 0;
+    stack[0] = blocks_in_rpo[i];
+    next_child[0] = stack[0]->dominated;
+    stack[0]->dom_pre_number = pre_number++;
+    while (top >= 0) {
+      blist_node *child = next_child[top];
+      if (child) {
+        next_child[top] = child->next;
+        top++;
+        stack[top] = child->block;
+        next_child[top] = child->block->dominated;
+        child->block->dom_pre_number = pre_number++;
+      } else {
+        stack[top]->dom_post_number = post_number++;
+        top--;
+      }
+    }
   }
 
-  return set;
+  free(stack);
+  free(next_child);
+}
+
+bool is_reachable(bnode *block) {
+  return block->rpo_number < num_reachable_blocks;
+}
+
+bool dominates(bnode *dominator, bnode *block) {
+  return dominator->dom_pre_number <= block->dom_pre_number &&
+         block->dom_post_number <= dominator->dom_post_number;
+}
+
+set get_dominators(bnode *block) {
+  set dominators = create_empty_set(get_num_created_blocks());
+  while (block) {
+    add_to_set(block->id, dominators);
+    block = block->idom;
+  }
+  return dominators;
 }
 
 void print_control_flow_graph(FILE* file) {
-  blist_node *block_list_head = get_all_blocks();
-  blist_node *block_list_node = block_list_head;
+  bnode **blocks = get_all_blocks();
 
   fprintf(file, "\n");
-  while (block_list_node) {
-    fprintf(file, "Block %d [Leader: ", block_list_node->block->id);
-    print_instruction(block_list_node->block->first_instruction, file);
+  for (int i = 0; i < get_num_created_blocks(); i++) {
+    fprintf(file, "Block %d [Leader: ", blocks[i]->id);
+    print_instruction(blocks[i]->first_instruction, file);
     fprintf(file, "] -> ");
-    blist_node *block_list_child = block_list_node->block->children;
-    while (block_list_child) {
-      if (block_list_child->next) {
-        fprintf(file, "%d, ", block_list_child->block->id);
+    for (int j = 0; j < blocks[i]->num_successors; j++) {
+      if (j + 1 < blocks[i]->num_successors) {
+        fprintf(file, "%d, ", blocks[i]->successors[j]->id);
       } else {
-        fprintf(file, "%d\n", block_list_child->block->id);
+        fprintf(file, "%d\n", blocks[i]->successors[j]->id);
       }
-      block_list_child = block_list_child->next;
     }
-
-    block_list_node = block_list_node->next;
   }
 }
 
+int get_num_blocks() { return num_blocks; }
+
+bnode **get_blocks_in_reverse_postorder() { return blocks_in_rpo; }
+
 int get_total_instructions() { return total_instructions; }
 
 int get_total_assignment_instructions() {
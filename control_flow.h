@@ -25,6 +25,55 @@ void build_control_flow_graph(inode* instruction_head);
  */
 void print_control_flow_graph(FILE* file);
 
+/**
+ * Gets the number of blocks in the control flow graph of the function.
+ *
+ * @return
+ */
+int get_num_blocks();
+
+/**
+ * Gets the blocks of the control flow graph in reverse postorder of a
+ * depth-first traversal from the entry block. Blocks that cannot be reached
+ * from the entry come last. Forward data-flow problems converge faster when
+ * blocks are visited in this order, and backward ones when they are visited in
+ * the opposite order (postorder).
+ *
+ * @return Array of blocks indexed by their rpo_number
+ */
+bnode **get_blocks_in_reverse_postorder();
+
+/**
+ * Checks whether a block can be reached from the entry block.
+ *
+ * @param block: block
+ *
+ * @return
+ */
+bool is_reachable(bnode *block);
+
+/**
+ * Checks whether a block dominates another one, i.e., whether every path from
+ * the entry to the second block goes through the first. A block dominates
+ * itself. It takes constant time.
+ *
+ * @param dominator: candidate dominator
+ * @param block: block
+ *
+ * @return
+ */
+bool dominates(bnode *dominator, bnode *block);
+
+/**
+ * Gets the ids of all the blocks that dominate a block, by walking up the
+ * dominator tree.
+ *
+ * @param block: block
+ *
+ * @return New set with the dominators of the block
+ */
+set get_dominators(bnode *block);
+
 /**
  * Gets the total number of instructions created within a function.
  *
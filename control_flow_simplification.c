@@ -0,0 +1,296 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#include "control_flow_simplification.h"
+
+static bool remove_unreachable_blocks();
+static bool merge_blocks();
+static bool thread_jumps(inode *instruction_head);
+static bool remove_redundant_jumps(inode *instruction_head);
+static void remove_unused_labels(inode *instruction_head);
+static bool is_jump(inode *instruction);
+static bool falls_into(inode *instruction, inode *label);
+static inode *get_next_live_instruction(inode *instruction, bool skip_labels);
+static inode *get_last_live_instruction(bnode *block);
+static void move_instructions(inode *first, inode *last, inode *position);
+
+void simplify_control_flow_graph(inode *instruction_head) {
+  bool changed = true;
+  while (changed) {
+    changed = remove_unreachable_blocks();
+    changed = merge_blocks() || changed;
+    changed = thread_jumps(instruction_head) || changed;
+    changed = remove_redundant_jumps(instruction_head) || changed;
+    if (changed) {
+      build_control_flow_graph(instruction_head);
+    }
+  }
+  remove_unused_labels(instruction_head);
+}
+
+/**
+ * Removes the instructions of the blocks that cannot be reached from the
+ * entry block.
+ *
+ * @return Whether any instruction was removed.
+ */
+bool remove_unreachable_blocks() {
+  bool changed = false;
+  bnode **blocks = get_all_blocks();
+  for (int i = 0; i < get_num_created_blocks(); i++) {
+    if (is_reachable(blocks[i])) {
+      continue;
+    }
+
+    FOR_EACH_INSTRUCTION_IN_BLOCK(instruction, blocks[i]) {
+      if (!instruction->dead) {
+        instruction->dead = true;
+        changed = true;
+      }
+    }
+  }
+
+  return changed;
+}
+
+/**
+ * Moves each block that is only reached by an unconditional jump right after
+ * the jump, which is removed. The two blocks become one when the control flow
+ * graph is rebuilt. Only blocks that never fall through are moved, so the
+ * instructions around their original position are not affected.
+ *
+ * @return Whether any block was moved.
+ */
+bool merge_blocks() {
+  bool changed = false;
+  int n = get_num_created_blocks();
+  bnode **blocks = get_all_blocks();
+  // A block that has been moved, or that had a block moved after it, must
+  // stay where it is until the control flow graph is rebuilt.
+  bool *moved = zalloc(n * sizeof(bool));
+
+  for (int i = 0; i < n; i++) {
+    bnode *block = blocks[i];
+    inode *jump = get_last_live_instruction(block);
+    if (!jump || jump->op_type != OP_Goto || !is_reachable(block) ||
+        moved[block->id]) {
+      continue;
+    }
+
+    bnode *target = jump->jump_to->block;
+    inode *target_exit = get_last_live_instruction(target);
+    if (target == block || target->num_predecessors != 1 ||
+        moved[target->id] || !target_exit ||
+        (target_exit->op_type != OP_Goto &&
+         target_exit->op_type != OP_Return) ||
+        falls_into(jump, jump->jump_to)) {
+      continue;
+    }
+
+    move_instructions(target->first_instruction, target->last_instruction,
+                      block->last_instruction);
+    jump->dead = true;
+    moved[block->id] = true;
+    moved[target->id] = true;
+    changed = true;
+  }
+  free(moved);
+
+  return changed;
+}
+
+/**
+ * Redirects jumps whose destination is an unconditional jump to the final
+ * destination of the chain of jumps.
+ *
+ * @param instruction_head: first instruction of a function
+ *
+ * @return Whether any jump was redirected.
+ */
+bool thread_jumps(inode *instruction_head) {
+  bool changed = false;
+  // A longer chain must contain a cycle of unconditional jumps
+  int max_chain_length = get_num_created_blocks();
+
+  for (inode *instruction = instruction_head; instruction;
+       instruction = instruction->next) {
+    if (instruction->dead || !is_jump(instruction)) {
+      continue;
+    }
+
+    inode *label = instruction->jump_to;
+    for (int i = 0; i < max_chain_length; i++) {
+      inode *destination = get_next_live_instruction(label, true);
+      if (!destination || destination->op_type != OP_Goto ||
+          destination == instruction) {
+        break;
+      }
+      label = destination->jump_to;
+    }
+
+    if (label != instruction->jump_to) {
+      instruction->jump_to = label;
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+/**
+ * Removes jumps to the instruction that would be executed next anyway, and
+ * replaces a conditional jump over an unconditional one by the inverted
+ * conditional jump.
+ *
+ * @param instruction_head: first instruction of a function
+ *
+ * @return Whether any jump was removed.
+ */
+bool remove_redundant_jumps(inode *instruction_head) {
+  bool changed = false;
+
+  for (inode *instruction = instruction_head; instruction;
+       instruction = instruction->next) {
+    if (instruction->dead || !is_jump(instruction)) {
+      continue;
+    }
+
+    if (falls_into(instruction, instruction->jump_to)) {
+      // Conditions have no side effects, so a conditional jump to the next
+      // instruction can be removed as well.
+      instruction->dead = true;
+      changed = true;
+      continue;
+    }
+
+    if (instruction->op_type == OP_If) {
+      inode *next = get_next_live_instruction(instruction->next, false);
+      if (next && next->op_type == OP_Goto &&
+          falls_into(next, instruction->jump_to)) {
+        invert_boolean_operator(instruction);
+        instruction->jump_to = next->jump_to;
+        next->dead = true;
+        changed = true;
+      }
+    }
+  }
+
+  return changed;
+}
+
+/**
+ * Removes the labels that are not the destination of any jump.
+ *
+ * @param instruction_head: first instruction of a function
+ */
+void remove_unused_labels(inode *instruction_head) {
+  // Labels are identified by their order in the list of instructions
+  set used_labels = create_empty_set(get_total_instructions());
+  for (inode *instruction = instruction_head; instruction;
+       instruction = instruction->next) {
+    if (!instruction->dead && is_jump(instruction)) {
+      add_to_set(instruction->jump_to->order, used_labels);
+    }
+  }
+
+  for (inode *instruction = instruction_head; instruction;
+       instruction = instruction->next) {
+    if (instruction->op_type == OP_Label &&
+        !does_elto_belong_to_set(instruction->order, used_labels)) {
+      instruction->dead = true;
+    }
+  }
+  free_set(used_labels);
+}
+
+/**
+ * Checks whether an instruction is a conditional or unconditional jump.
+ *
+ * @param instruction: instruction
+ *
+ * @return
+ */
+bool is_jump(inode *instruction) {
+  return instruction->op_type == OP_If || instruction->op_type == OP_Goto;
+}
+
+/**
+ * Checks whether the execution reaches a label right after an instruction,
+ * i.e., whether there are only labels and dead instructions between them.
+ *
+ * @param instruction: instruction
+ * @param label: label
+ *
+ * @return
+ */
+bool falls_into(inode *instruction, inode *label) {
+  inode *next = instruction->next;
+  while (next && (next->dead || next->op_type == OP_Label)) {
+    if (next == label) {
+      return true;
+    }
+    next = next->next;
+  }
+
+  return false;
+}
+
+/**
+ * Gets the first instruction from a given one that is not dead.
+ *
+ * @param instruction: instruction to start from
+ * @param skip_labels: whether labels must be skipped as well
+ *
+ * @return Live instruction or NULL if there is none.
+ */
+inode *get_next_live_instruction(inode *instruction, bool skip_labels) {
+  while (instruction &&
+         (instruction->dead ||
+          (skip_labels && instruction->op_type == OP_Label))) {
+    instruction = instruction->next;
+  }
+
+  return instruction;
+}
+
+/**
+ * Gets the last instruction of a block that is not dead.
+ *
+ * @param block: block
+ *
+ * @return Live instruction or NULL if all the instructions of the block are
+ * dead.
+ */
+inode *get_last_live_instruction(bnode *block) {
+  FOR_EACH_INSTRUCTION_IN_BLOCK_REVERSE(instruction, block) {
+    if (!instruction->dead) {
+      return instruction;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Moves a sequence of instructions to another position in the list of
+ * instructions.
+ *
+ * @param first: first instruction of the sequence
+ * @param last: last instruction of the sequence
+ * @param position: instruction after which the sequence is placed
+ */
+void move_instructions(inode *first, inode *last, inode *position) {
+  first->previous->next = last->next;
+  if (last->next) {
+    last->next->previous = first->previous;
+  }
+
+  last->next = position->next;
+  if (position->next) {
+    position->next->previous = last;
+  }
+  position->next = first;
+  first->previous = position;
+}
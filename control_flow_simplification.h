@@ -0,0 +1,23 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#ifndef CSC553_CONTROL_FLOW_SIMPLIFICATION_H
+#define CSC553_CONTROL_FLOW_SIMPLIFICATION_H
+
+#include "control_flow.h"
+
+/**
+ * Simplifies the control flow graph of a function until no more changes are
+ * possible. Unreachable blocks are removed, jumps to jumps are redirected to
+ * their final destination, jumps to the next instruction are removed, a block
+ * reached only by a jump is moved after the jump, and labels no longer used
+ * are removed. Removed instructions are marked as dead. The control flow graph
+ * is rebuilt if any change is made.
+ *
+ * @param instruction_head: first instruction of a function
+ */
+void simplify_control_flow_graph(inode *instruction_head);
+
+#endif // CSC553_CONTROL_FLOW_SIMPLIFICATION_H
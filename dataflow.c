@@ -0,0 +1,225 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#include "dataflow.h"
+
+static void iterate_until_fixed_point(df_problem *problem, set worklist);
+static bool apply_gen_and_kill(df_problem *problem, int block_id);
+static void meet_neighbors(df_problem *problem, bnode *block);
+static int get_position_in_visiting_order(df_problem *problem, bnode *block);
+
+df_problem *create_dataflow_problem(df_direction direction, df_meet meet,
+                                    df_initializer initial,
+                                    df_initializer boundary, int num_elements) {
+  df_problem *problem = zalloc(sizeof(df_problem));
+  problem->direction = direction;
+  problem->meet = meet;
+  problem->transfer = apply_gen_and_kill;
+  problem->initial = initial;
+  problem->boundary = boundary(num_elements);
+  problem->num_elements = num_elements;
+  problem->num_blocks = get_num_created_blocks();
+
+  int n = problem->num_blocks;
+  problem->gen = zalloc(n * sizeof(set));
+  problem->kill = zalloc(n * sizeof(set));
+  problem->in = zalloc(n * sizeof(set));
+  problem->out = zalloc(n * sizeof(set));
+
+  for (int id = 0; id < n; id++) {
+    problem->gen[id] = create_empty_set(num_elements);
+    problem->kill[id] = create_empty_set(num_elements);
+    problem->in[id] = initial(num_elements);
+    problem->out[id] = initial(num_elements);
+  }
+
+  return problem;
+}
+
+void solve_dataflow_problem(df_problem *problem) {
+  set worklist = create_full_set(get_num_blocks());
+  iterate_until_fixed_point(problem, worklist);
+  free_set(worklist);
+}
+
+void resolve_dataflow_problem(df_problem *problem, set changed_blocks) {
+  // Only the blocks from which a changed block can be reached (or that can be
+  // reached from a changed block, for forward problems) may have different
+  // facts. They are reset to the initial facts, so that the least fixed point
+  // is found again even if the new facts are smaller than the current ones.
+  bool forward = problem->direction == DF_Forward;
+  set affected_blocks = clone_set(changed_blocks);
+  set pending_blocks = clone_set(changed_blocks);
+  bnode **blocks = get_all_blocks();
+
+  int id = get_next_elto_in_set(0, pending_blocks);
+  while (id >= 0) {
+    remove_from_set(id, pending_blocks);
+    int num_neighbors =
+        forward ? blocks[id]->num_successors : blocks[id]->num_predecessors;
+    bnode **neighbors =
+        forward ? blocks[id]->successors : blocks[id]->predecessors;
+    for (int i = 0; i < num_neighbors; i++) {
+      if (!does_elto_belong_to_set(neighbors[i]->id, affected_blocks)) {
+        add_to_set(neighbors[i]->id, affected_blocks);
+        add_to_set(neighbors[i]->id, pending_blocks);
+      }
+    }
+    id = get_next_elto_in_set(0, pending_blocks);
+  }
+
+  set initial_facts = problem->initial(problem->num_elements);
+  set worklist = create_empty_set(get_num_blocks());
+  FOR_EACH_ELTO_IN_SET(i, affected_blocks) {
+    copy_set(problem->in[i], initial_facts);
+    copy_set(problem->out[i], initial_facts);
+    add_to_set(get_position_in_visiting_order(problem, blocks[i]), worklist);
+  }
+  iterate_until_fixed_point(problem, worklist);
+
+  free_set(worklist);
+  free_set(initial_facts);
+  free_set(affected_blocks);
+  free_set(pending_blocks);
+}
+
+/**
+ * Visits the blocks in a worklist until it is empty. Blocks are visited in
+ * reverse postorder (postorder, for backward problems), and the dependents of
+ * a block are added to the worklist whenever its facts change.
+ *
+ * @param problem: problem
+ * @param worklist: positions of the blocks to visit in the visiting order. It
+ * is empty at the end.
+ */
+void iterate_until_fixed_point(df_problem *problem, set worklist) {
+  bool forward = problem->direction == DF_Forward;
+  int n = get_num_blocks();
+  bnode **blocks_in_rpo = get_blocks_in_reverse_postorder();
+
+  int position = get_next_elto_in_set(0, worklist);
+  while (position >= 0) {
+    remove_from_set(position, worklist);
+    bnode *block = blocks_in_rpo[forward ? position : n - 1 - position];
+    meet_neighbors(problem, block);
+    if (problem->transfer(problem, block->id)) {
+      int num_dependents =
+          forward ? block->num_successors : block->num_predecessors;
+      bnode **dependents = forward ? block->successors : block->predecessors;
+      for (int i = 0; i < num_dependents; i++) {
+        add_to_set(get_position_in_visiting_order(problem, dependents[i]),
+                   worklist);
+      }
+    }
+
+    position = get_next_elto_in_set(position + 1, worklist);
+    if (position < 0) {
+      position = get_next_elto_in_set(0, worklist);
+    }
+  }
+}
+
+/**
+ * Default transfer function: result = gen U (source - kill).
+ *
+ * @param problem: problem
+ * @param block_id: block id
+ *
+ * @return Whether the result changed.
+ */
+bool apply_gen_and_kill(df_problem *problem, int block_id) {
+  if (problem->direction == DF_Forward) {
+    return apply_transfer_function(problem->out[block_id],
+                                   problem->gen[block_id],
+                                   problem->in[block_id],
+                                   problem->kill[block_id]);
+  } else {
+    return apply_transfer_function(problem->in[block_id],
+                                   problem->gen[block_id],
+                                   problem->out[block_id],
+                                   problem->kill[block_id]);
+  }
+}
+
+/**
+ * Combines the facts of the predecessors (successors, for backward problems)
+ * of a block into its in (out) set.
+ *
+ * @param problem: problem
+ * @param block: block
+ */
+void meet_neighbors(df_problem *problem, bnode *block) {
+  int num_neighbors;
+  bnode **neighbors;
+  set target;
+  set *neighbor_facts;
+  if (problem->direction == DF_Forward) {
+    num_neighbors = block->num_predecessors;
+    neighbors = block->predecessors;
+    target = problem->in[block->id];
+    neighbor_facts = problem->out;
+  } else {
+    num_neighbors = block->num_successors;
+    neighbors = block->successors;
+    target = problem->out[block->id];
+    neighbor_facts = problem->in;
+  }
+
+  if (num_neighbors == 0) {
+    copy_set(target, problem->boundary);
+    return;
+  }
+
+  copy_set(target, neighbor_facts[neighbors[0]->id]);
+  for (int i = 1; i < num_neighbors; i++) {
+    problem->meet(target, neighbor_facts[neighbors[i]->id]);
+  }
+}
+
+/**
+ * Gets the position of a block in the order in which the blocks of a problem
+ * are visited.
+ *
+ * @param problem: problem
+ * @param block: block
+ *
+ * @return Position
+ */
+int get_position_in_visiting_order(df_problem *problem, bnode *block) {
+  if (problem->direction == DF_Forward) {
+    return block->rpo_number;
+  } else {
+    return get_num_blocks() - 1 - block->rpo_number;
+  }
+}
+
+set detach_dataflow_in_set(df_problem *problem, int block_id) {
+  set null_set = {0};
+  set detached = problem->in[block_id];
+  problem->in[block_id] = null_set;
+  return detached;
+}
+
+set detach_dataflow_out_set(df_problem *problem, int block_id) {
+  set null_set = {0};
+  set detached = problem->out[block_id];
+  problem->out[block_id] = null_set;
+  return detached;
+}
+
+void free_dataflow_problem(df_problem *problem) {
+  for (int i = 0; i < problem->num_blocks; i++) {
+    free_set(problem->gen[i]);
+    free_set(problem->kill[i]);
+    free_set(problem->in[i]);
+    free_set(problem->out[i]);
+  }
+  free(problem->gen);
+  free(problem->kill);
+  free(problem->in);
+  free(problem->out);
+  free_set(problem->boundary);
+  free(problem);
+}
@@ -0,0 +1,114 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#ifndef CSC553_DATAFLOW_H
+#define CSC553_DATAFLOW_H
+
+#include "control_flow.h"
+
+typedef enum DataflowDirection { DF_Forward, DF_Backward } df_direction;
+
+struct DataflowProblem;
+
+// Combines the facts of a neighbor into the target set. Returns whether the
+// target changed (e.g. unify_sets_in_place or intersect_sets_in_place).
+typedef bool (*df_meet)(set target, set other);
+
+// Computes the facts at the exit of a block (entry, for backward problems) from
+// the facts at its entry (exit). Returns whether the result changed.
+typedef bool (*df_transfer)(struct DataflowProblem *problem, int block_id);
+
+// Creates the initial facts of a block (e.g. create_empty_set or
+// create_full_set).
+typedef set (*df_initializer)(int max_size);
+
+// A data-flow problem over the blocks of the current control flow graph. The
+// facts of each block are stored in arrays indexed by the block id. The in and
+// out sets refer to the entry and exit of a block in program order,
+// regardless of the direction of the problem.
+typedef struct DataflowProblem {
+  df_direction direction;
+  df_meet meet;
+  df_transfer transfer;
+  df_initializer initial;
+  set boundary;
+
+  int num_elements;
+  int num_blocks;
+
+  set *gen;
+  set *kill;
+  set *in;
+  set *out;
+} df_problem;
+
+/**
+ * Creates a data-flow problem for the blocks of the current control flow
+ * graph. The gen and kill sets of every block are created empty, to be filled
+ * by the analysis. The transfer function defaults to
+ * result = gen U (source - kill).
+ *
+ * @param direction: direction in which the facts propagate
+ * @param meet: function that combines the facts of the neighbors of a block
+ * @param initial: facts of a block before the first iteration (the top of the
+ * lattice for the given meet)
+ * @param boundary: facts at the entry (exit, for backward problems) of blocks
+ * without predecessors (successors)
+ * @param num_elements: maximum number of elements in the sets
+ *
+ * @return Problem
+ */
+df_problem *create_dataflow_problem(df_direction direction, df_meet meet,
+                                    df_initializer initial,
+                                    df_initializer boundary, int num_elements);
+
+/**
+ * Iterates the data-flow equations until a fixed point is found. Blocks are
+ * kept in a worklist and visited in reverse postorder (postorder, for backward
+ * problems); a block is only revisited when the facts of one of its neighbors
+ * change.
+ *
+ * @param problem: problem
+ */
+void solve_dataflow_problem(df_problem *problem);
+
+/**
+ * Finds the new fixed point of a solved problem after the gen and kill sets of
+ * some blocks changed. Only the facts of the blocks affected by the change are
+ * recomputed.
+ *
+ * @param problem: solved problem
+ * @param changed_blocks: ids of the blocks whose gen or kill sets changed
+ */
+void resolve_dataflow_problem(df_problem *problem, set changed_blocks);
+
+/**
+ * Takes the in set of a block out of the problem, so that it outlives it.
+ *
+ * @param problem: problem
+ * @param block_id: block id
+ *
+ * @return In set of the block
+ */
+set detach_dataflow_in_set(df_problem *problem, int block_id);
+
+/**
+ * Takes the out set of a block out of the problem, so that it outlives it.
+ *
+ * @param problem: problem
+ * @param block_id: block id
+ *
+ * @return Out set of the block
+ */
+set detach_dataflow_out_set(df_problem *problem, int block_id);
+
+/**
+ * Releases the memory used by a problem and by the sets it still owns.
+ *
+ * @param problem: problem
+ */
+void free_dataflow_problem(df_problem *problem);
+
+#endif // CSC553_DATAFLOW_H
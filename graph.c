@@ -1,151 +1,205 @@
 #include "graph.h"
 
-gnode_list_item *create_graph() {
-  gnode_list_item *graph_head = zalloc(sizeof(gnode_list_item *));
-  graph_head->node = NULL;
-  graph_head->prev = NULL;
-  graph_head->next = NULL;
-
-  return graph_head;
+static size_t get_edge_position(int id1, int id2);
+static void add_neighbor(gnode *node, gnode *neighbor);
+static void add_move_to_node(gnode *node, int move_id);
+
+graph *create_graph(int max_nodes) {
+  graph *new_graph = zalloc(sizeof(graph));
+  new_graph->max_nodes = max_nodes;
+  new_graph->nodes = zalloc(max_nodes * sizeof(gnode *));
+  new_graph->num_nodes = 0;
+  // Allocated with the first edge, so graphs without edges do not pay for it
+  new_graph->adjacency_matrix = NULL;
+
+  return new_graph;
 }
 
-gnode *create_graph_node(int id, int max_neighbors) {
+gnode *create_graph_node(int id) {
   gnode *node = zalloc(sizeof(gnode));
   node->id = id;
   node->reg = -1;
   node->neighbors = NULL;
   node->num_neighbors = 0;
-  node->neighbor_set = create_empty_set(max_neighbors);
+  node->neighbors_capacity = 0;
+  node->degree = 0;
+  node->removed = false;
+  node->moves = NULL;
+  node->num_moves = 0;
+  node->moves_capacity = 0;
+  node->alias = NULL;
 
   return node;
 }
 
-gnode_list_item *add_node_to_graph(gnode *node, gnode_list_item *graph_head) {
-  gnode_list_item *new_item = zalloc(sizeof(gnode_list_item));
-  new_item->node = node;
-  new_item->prev = NULL;
-  new_item->next = NULL;
-
-  if (graph_head) {
-    // Add a new item in the beginning of the list of nodes from a graph
-    new_item->next = graph_head;
-    graph_head->prev = new_item;
-  }
-
-  return new_item;
+void add_node_to_graph(gnode *node, graph *graph) {
+  graph->nodes[node->id] = node;
+  graph->num_nodes++;
 }
 
-void add_edge(gnode *node1, gnode *node2) {
-  if (does_elto_belong_to_set(node1->id, node2->neighbor_set)) {
-    // No multiple edges between the same nodes.
+void add_edge(gnode *node1, gnode *node2, graph *graph) {
+  if (node1 == node2 || are_nodes_adjacent(node1, node2, graph)) {
+    // No self-loops or multiple edges between the same nodes.
     return;
   }
 
-  // Add node2 to the list of neighbors of node1
-  gnode_list_item *new_item = zalloc(sizeof(gnode_list_item));
-  new_item->node = node2;
-  if (node1->neighbors) {
-    new_item->next = node1->neighbors;
-    node1->neighbors->prev = new_item;
-  }
-  node1->neighbors = new_item;
-  node1->num_neighbors++;
-  add_to_set(node2->id, node1->neighbor_set);
-
-  // Add node1 to the list of neighbors of node2
-  new_item = zalloc(sizeof(gnode_list_item));
-  new_item->node = node1;
-  if (node2->neighbors) {
-    new_item->next = node2->neighbors;
-    node2->neighbors->prev = new_item;
+  if (!graph->adjacency_matrix) {
+    // One bit for each pair of distinct nodes
+    size_t num_words = get_edge_position(graph->max_nodes, 0) / 64 + 1;
+    graph->adjacency_matrix = zalloc(num_words * sizeof(uint64_t));
   }
-  node2->neighbors = new_item;
-  node2->num_neighbors++;
-  add_to_set(node1->id, node2->neighbor_set);
+  size_t position = get_edge_position(node1->id, node2->id);
+  graph->adjacency_matrix[position / 64] |= (uint64_t)1 << (position % 64);
+  add_neighbor(node1, node2);
+  add_neighbor(node2, node1);
 }
 
-gnode_list_item *remove_node_from_graph(gnode_list_item *graph_item,
-                                        gnode_list_item *graph_head) {
-
-  if (!graph_head || !graph_item) {
-    return graph_head;
+void add_move(gnode *node1, gnode *node2, long long frequency,
+              graph *graph) {
+  for (int i = 0; i < node1->num_moves; i++) {
+    gmove *move = &graph->moves[node1->moves[i]];
+    if ((move->node1 == node1 && move->node2 == node2) ||
+        (move->node1 == node2 && move->node2 == node1)) {
+      move->frequency += frequency;
+      return;
+    }
   }
 
-  // Remove edges
-  gnode_list_item *neighbor = graph_item->node->neighbors;
-  while (neighbor) {
-    neighbor->node->num_neighbors--;
-
-    if (neighbor->node->neighbors->node == graph_item->node) {
-      // Node is the first in the list
-      gnode_list_item *tmp = neighbor->node->neighbors;
-      neighbor->node->neighbors = neighbor->node->neighbors->next;
-      tmp->next = NULL;
-      free(tmp);
-    } else {
-      // Find the node in the list of neighbors of its neighbor
-      gnode_list_item *tmp = neighbor->node->neighbors;
-      while (tmp->node != graph_item->node) {
-        // TODO - O(n) search. Change strategy if this becomes a bottleneck.
-        tmp = tmp->next;
-      }
+  if (graph->num_moves == graph->moves_capacity) {
+    graph->moves_capacity =
+        graph->moves_capacity ? 2 * graph->moves_capacity : 16;
+    graph->moves =
+        realloc(graph->moves, graph->moves_capacity * sizeof(gmove));
+  }
+  gmove *move = &graph->moves[graph->num_moves];
+  move->node1 = node1;
+  move->node2 = node2;
+  move->frequency = frequency;
+  move->state = MS_Worklist;
+  add_move_to_node(node1, graph->num_moves);
+  add_move_to_node(node2, graph->num_moves);
+  graph->num_moves++;
+}
 
-      tmp->prev->next = tmp->next;
-      if (tmp->next) {
-        tmp->next->prev = tmp->prev;
-      }
+bool are_nodes_adjacent(gnode *node1, gnode *node2, graph *graph) {
+  if (node1 == node2 || !graph->adjacency_matrix) {
+    return false;
+  }
 
-      // Free memory
-      tmp->node = NULL;
-      tmp->prev = NULL;
-      tmp->next = NULL;
-      // Do not free the node itself because it carry instructions about
-      // location where the variable must be allocated (register or memory).
-      // Just remove it from the graph.
-      free(tmp);
-    }
+  size_t position = get_edge_position(node1->id, node2->id);
+  return (graph->adjacency_matrix[position / 64] >> (position % 64)) & 1;
+}
 
-    neighbor = neighbor->next;
+void remove_node_from_graph(gnode *node, graph *graph) {
+  if (node->removed) {
+    return;
   }
 
-  // Remove node from the list of nodes in the graph
-  graph_item->node->neighbors = NULL;
-  graph_item->node = NULL;
-  gnode_list_item *new_head = graph_head;
-  if (graph_item == graph_head) {
-    new_head = graph_item->next;
-    graph_item->next = NULL;
-  } else {
-    graph_item->prev->next = graph_item->next;
-    if (graph_item->next) {
-      graph_item->next->prev = graph_item->prev;
-    }
-  }
-  free(graph_item);
+  FOR_EACH_NEIGHBOR(neighbor, node) { neighbor->degree--; }
+  node->removed = true;
+  graph->num_nodes--;
+}
 
-  if (new_head) {
-    new_head->prev = NULL;
+void merge_nodes(gnode *node, gnode *merged_node, graph *graph) {
+  merged_node->alias = node;
+  for (int i = 0; i < merged_node->num_moves; i++) {
+    add_move_to_node(node, merged_node->moves[i]);
   }
+  FOR_EACH_NEIGHBOR(neighbor, merged_node) { add_edge(neighbor, node, graph); }
+  remove_node_from_graph(merged_node, graph);
+}
 
-  return new_head;
+gnode *get_alias(gnode *node) {
+  while (node->alias) {
+    node = node->alias;
+  }
+  return node;
 }
 
-void print_graph(gnode_list_item *graph_head, FILE *file) {
+void print_graph(graph *graph, FILE *file) {
   fprintf(file, "GRAPH \n");
   fprintf(file, "----- \n");
-  gnode_list_item *item = graph_head;
-  while (item) {
-    fprintf(file, "%d: ", item->node->id);
-    gnode_list_item *neighbor = item->node->neighbors;
-    while (neighbor) {
-      if (neighbor->next) {
-        fprintf(file, "%d, ", neighbor->node->id);
-      } else {
-        fprintf(file, "%d", neighbor->node->id);
+  for (int id = graph->max_nodes - 1; id >= 0; id--) {
+    gnode *node = graph->nodes[id];
+    if (!node || node->removed) {
+      continue;
+    }
+
+    fprintf(file, "%d: ", node->id);
+    bool first = true;
+    for (int i = node->num_neighbors - 1; i >= 0; i--) {
+      if (!node->neighbors[i]->removed) {
+        fprintf(file, first ? "%d" : ", %d", node->neighbors[i]->id);
+        first = false;
       }
-      neighbor = neighbor->next;
     }
     fprintf(file, "\n");
-    item = item->next;
   }
 }
+
+void free_graph(graph *graph) {
+  free(graph->nodes);
+  free(graph->adjacency_matrix);
+  free(graph->moves);
+  free(graph);
+}
+
+void free_graph_node(gnode *node) {
+  if (node) {
+    free(node->neighbors);
+    free(node->moves);
+    free_set(node->regs_to_avoid);
+    free_set(node->preferential_regs);
+    free(node);
+  }
+}
+
+/**
+ * Computes the position of the bit of an edge in the lower triangular
+ * adjacency matrix. Row i stores the edges to the nodes with ids smaller than
+ * i.
+ *
+ * @param id1: id of a node
+ * @param id2: id of the other node
+ *
+ * @return Position of the bit.
+ */
+size_t get_edge_position(int id1, int id2) {
+  size_t row = id1 > id2 ? id1 : id2;
+  size_t column = id1 > id2 ? id2 : id1;
+  return row * (row - 1) / 2 + column;
+}
+
+/**
+ * Appends a node to the adjacency array of another, growing the array if
+ * needed.
+ *
+ * @param node: node
+ * @param neighbor: new neighbor
+ */
+void add_neighbor(gnode *node, gnode *neighbor) {
+  if (node->num_neighbors == node->neighbors_capacity) {
+    node->neighbors_capacity =
+        node->neighbors_capacity ? 2 * node->neighbors_capacity : 4;
+    node->neighbors = realloc(node->neighbors,
+                              node->neighbors_capacity * sizeof(gnode *));
+  }
+  node->neighbors[node->num_neighbors++] = neighbor;
+  if (!neighbor->removed) {
+    node->degree++;
+  }
+}
+
+/**
+ * Appends a move to the list of moves of a node, growing the list if needed.
+ *
+ * @param node: node
+ * @param move_id: id of the move
+ */
+void add_move_to_node(gnode *node, int move_id) {
+  if (node->num_moves == node->moves_capacity) {
+    node->moves_capacity = node->moves_capacity ? 2 * node->moves_capacity : 4;
+    node->moves = realloc(node->moves, node->moves_capacity * sizeof(int));
+  }
+  node->moves[node->num_moves++] = move_id;
+}
@@ -19,64 +19,180 @@ typedef struct NodeListItem {
   struct NodeListItem *prev;
 } gnode_list_item;
 
+// State of a copy between two nodes during coalescing
+typedef enum MoveState {
+  MS_Worklist,    // Candidate to be coalesced
+  MS_Active,      // Not yet ready to be coalesced
+  MS_Coalesced,   // Both nodes were merged
+  MS_Constrained, // Both nodes interfere
+  MS_Frozen,      // Given up to simplify one of the nodes
+} move_state;
+
+// Copy between the live ranges of two nodes
+typedef struct GraphMove {
+  gnode *node1;
+  gnode *node2;
+  long long frequency; // Estimated number of times the copy is executed
+  move_state state;
+} gmove;
+
 typedef struct GraphNode {
   int id;
   int reg; // register where the live range is allocated (-1 if in memory)
   set regs_to_avoid;
+  // All the neighbors of the node, including the ones already removed from
+  // the graph
+  struct GraphNode **neighbors;
   int num_neighbors;
-  gnode_list_item *neighbors;
-  set neighbor_set;
-  int cost;
+  int neighbors_capacity;
+  int degree;   // Number of neighbors still in the graph
+  bool removed; // Whether the node was (logically) removed from the graph
+  // Ids of the moves involving the node
+  int *moves;
+  int num_moves;
+  int moves_capacity;
+  struct GraphNode *alias; // Node it was coalesced into (NULL if none)
+  long long cost;
   set preferential_regs; // Set of preferential registers to use
 } gnode;
 
+// Interference graph. Edges are stored twice: in a lower triangular bit
+// matrix, for constant time queries of whether two nodes interfere, and in
+// the adjacency arrays of the nodes, for fast visits to the neighbors of a
+// node.
+typedef struct Graph {
+  int max_nodes;
+  gnode **nodes; // Nodes indexed by id (NULL if the id is not in the graph)
+  int num_nodes; // Number of nodes not removed from the graph
+  uint64_t *adjacency_matrix;
+  gmove *moves; // Moves indexed by id
+  int num_moves;
+  int moves_capacity;
+} graph;
+
+/**
+ * Iterates over the neighbors of a node that were not removed from the graph.
+ *
+ * @param neighbor: name of the gnode* variable that receives each neighbor
+ * @param node: node
+ */
+#define FOR_EACH_NEIGHBOR(neighbor, node)                                      \
+  for (gnode **neighbor##_item = (node)->neighbors,                            \
+             *neighbor = NULL;                                                 \
+       neighbor##_item != (node)->neighbors + (node)->num_neighbors;           \
+       neighbor##_item++)                                                      \
+    if ((neighbor = *neighbor##_item)->removed) {                              \
+    } else
+
+/**
+ * Creates an empty graph
+ *
+ * @param max_nodes: nodes in the graph have ids from 0 to max_nodes - 1
+ *
+ * @return New graph
+ */
+graph *create_graph(int max_nodes);
+
 /**
  * Creates a graph node
  *
- * @param var: live range variable
- * @param live_range: set of instructions part of the live range of the
- * variable
- * @param max_neighbors: maximum number of neighbors the node can have
+ * @param id: id of the node. Unique among the nodes of a graph.
  *
  * @return New graph node.
  */
-gnode *create_graph_node(int id, int max_neighbors);
+gnode *create_graph_node(int id);
 
 /**
  * Adds a node to a graph
  *
  * @param node: node
- * @param graph_head: head node in the list of nodes from a graph
+ * @param graph: graph
+ */
+void add_node_to_graph(gnode *node, graph *graph);
+
+/**
+ * Adds an edge between two nodes. Self-loops and multiple edges between the
+ * same nodes are ignored.
+ *
+ * @param node1: node1
+ * @param node2: node2
+ * @param graph: graph the nodes belong to
+ */
+void add_edge(gnode *node1, gnode *node2, graph *graph);
+
+/**
+ * Records a copy between two nodes. Copies between the same nodes are merged.
  *
- * @return new head of the list of nodes from a graph
+ * @param node1: node1
+ * @param node2: node2
+ * @param frequency: estimated number of times the copy is executed
+ * @param graph: graph the nodes belong to
  */
-gnode_list_item *add_node_to_graph(gnode *node, gnode_list_item *graph_head);
+void add_move(gnode *node1, gnode *node2, long long frequency,
+              graph *graph);
 
 /**
- * Adds an edge between two nodes
+ * Checks whether there is an edge between two nodes.
  *
  * @param node1: node1
  * @param node2: node2
+ * @param graph: graph the nodes belong to
+ *
+ * @return
+ */
+bool are_nodes_adjacent(gnode *node1, gnode *node2, graph *graph);
+
+/**
+ * Removes a node from a graph. The node and its edges are kept, but it is
+ * marked as removed and the degree of its neighbors is decremented.
+ *
+ * @param node: node
+ * @param graph: graph
+ */
+void remove_node_from_graph(gnode *node, graph *graph);
+
+/**
+ * Merges a node into another. The neighbors and moves of the merged node are
+ * added to the node it is merged into, and the merged node is removed from
+ * the graph.
+ *
+ * @param node: node that remains in the graph
+ * @param merged_node: node merged into the first one. They must not be
+ * neighbors.
+ * @param graph: graph
  */
-void add_edge(gnode *node1, gnode *node2);
+void merge_nodes(gnode *node, gnode *merged_node, graph *graph);
 
 /**
- * Remove a node from the list of nodes in a graph and from the list of
- * neighbors of its neighbors list
+ * Gets the node a node was coalesced into, following the chain of merges.
  *
- * @param graph_item: node item from the list of nodes in a graph
- * @param graph_head: head node in the list of nodes from a graph
+ * @param node: node
  *
- * @return new head of the list of nodes from a graph
+ * @return The node itself if it was not merged into another.
  */
-gnode_list_item *remove_node_from_graph(gnode_list_item *graph_item,
-                                        gnode_list_item *graph_head);
+gnode *get_alias(gnode *node);
 
 /**
  * Print the the graph's adjacency list
  *
- * @param graph_head: head in the list of nodes from a graph
+ * @param graph: graph
+ * @param file: file to print the graph to
+ */
+void print_graph(graph *graph, FILE *file);
+
+/**
+ * Frees the memory allocated to a graph. Its nodes are not freed, because they
+ * carry the location where each variable must be allocated.
+ *
+ * @param graph: graph
+ */
+void free_graph(graph *graph);
+
+/**
+ * Frees the memory allocated to a graph node.
+ *
+ * @param node: node
  */
-void print_graph(gnode_list_item *graph_head, FILE *file);
+void free_graph_node(gnode *node);
 
 #endif
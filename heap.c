@@ -2,80 +2,69 @@
 
 #include "global.h"
 
-heap *create_empty_heap(int max_size, bool min) {
-  heap *heap = zalloc(sizeof(heap));
-  heap->items = zalloc(max_size * sizeof(gnode *));
-  heap->min = min;
-  for(int i = 0; i < max_size; i++) {
-    heap->items[i] = NULL;
+static void place_item(heap *heap, gnode *item, int position);
+static void sift_up(heap *heap, int position);
+static void sift_down(heap *heap, int position);
+
+heap *create_empty_heap(int max_size, heap_comparator comes_first) {
+  heap *new_heap = zalloc(sizeof(*new_heap));
+  // Room for at least one item, as zalloc does not allocate empty blocks
+  new_heap->items = zalloc((max_size + 1) * sizeof(gnode *));
+  new_heap->positions = zalloc((max_size + 1) * sizeof(int));
+  for (int id = 0; id < max_size; id++) {
+    new_heap->positions[id] = -1;
   }
-  heap->size = 0;
-  return heap;
+  new_heap->size = 0;
+  new_heap->max_size = max_size;
+  new_heap->comes_first = comes_first;
+
+  return new_heap;
 }
 
 void add_to_heap(gnode *elto, heap *heap) {
-  heap->items[heap->size] = elto;
-  heap->size += 1;
-}
+  if (does_elto_belong_to_heap(elto, heap)) {
+    return;
+  }
 
-static void heapify(heap *heap, int min_node_idx) {
-  int left_child_idx = 2 * min_node_idx + 1;
-  int right_child_idx = 2 * min_node_idx + 2;
-  int new_max_node_idx = min_node_idx;
-
-  if (heap->min) {
-    // Min Heap
-    if (left_child_idx < heap->size &&
-        heap->items[left_child_idx]->cost <
-            heap->items[new_max_node_idx]->cost) {
-      new_max_node_idx = left_child_idx;
-    }
+  place_item(heap, elto, heap->size);
+  heap->size++;
+  sift_up(heap, heap->size - 1);
+}
 
-    if (right_child_idx < heap->size &&
-        heap->items[right_child_idx]->cost <
-            heap->items[new_max_node_idx]->cost) {
-      new_max_node_idx = right_child_idx;
-    }
-  } else {
-    // Max Heap
-    if (left_child_idx < heap->size &&
-        heap->items[left_child_idx]->cost >
-        heap->items[new_max_node_idx]->cost) {
-      new_max_node_idx = left_child_idx;
-    }
+void remove_from_heap(gnode *elto, heap *heap) {
+  if (!does_elto_belong_to_heap(elto, heap)) {
+    return;
+  }
 
-    if (right_child_idx < heap->size &&
-        heap->items[right_child_idx]->cost >
-        heap->items[new_max_node_idx]->cost) {
-      new_max_node_idx = right_child_idx;
-    }
+  int position = heap->positions[elto->id];
+  heap->positions[elto->id] = -1;
+  heap->size--;
+  if (position < heap->size) {
+    // The last item takes the place of the removed one and can move either way
+    place_item(heap, heap->items[heap->size], position);
+    sift_up(heap, position);
+    sift_down(heap, heap->positions[heap->items[position]->id]);
   }
+  heap->items[heap->size] = NULL;
+}
 
-  // Swap parent with the child with smallest/largest cost
-  if (min_node_idx != new_max_node_idx) {
-    gnode *item = heap->items[min_node_idx];
-    heap->items[min_node_idx] = heap->items[new_max_node_idx];
-    heap->items[new_max_node_idx] = item;
+bool does_elto_belong_to_heap(gnode *elto, heap *heap) {
+  return heap->positions[elto->id] >= 0;
+}
 
-    heapify(heap, new_max_node_idx);
-  }
+void decrease_heap_key(gnode *elto, heap *heap) {
+  sift_up(heap, heap->positions[elto->id]);
 }
 
-void build_heap(heap *heap) {
-  for (int i = heap->size - 1; i >= 0; i--) {
-    heapify(heap, i);
-  }
+void increase_heap_key(gnode *elto, heap *heap) {
+  sift_down(heap, heap->positions[elto->id]);
 }
 
 gnode *extract_heap_root(heap *heap) {
-  if (heap->size == 0)
-    return NULL;
-
-  gnode *root = heap->items[0];
-  heap->items[0] = heap->items[heap->size - 1];
-  heap->items[heap->size - 1] = NULL;
-  heap->size -= 1;
-  heapify(heap, 0);
+  gnode *root = peek_heap_root(heap);
+  if (root) {
+    remove_from_heap(root, heap);
+  }
 
   return root;
 }
@@ -85,4 +74,81 @@ gnode *peek_heap_root(heap *heap) {
     return NULL;
 
   return heap->items[0];
-}
\ No newline at end of file
+}
+
+void free_heap(heap *heap) {
+  free(heap->items);
+  free(heap->positions);
+  free(heap);
+}
+
+bool has_lower_cost(gnode *node1, gnode *node2) {
+  if (node1->cost != node2->cost) {
+    return node1->cost < node2->cost;
+  }
+  return node1->id < node2->id;
+}
+
+bool has_higher_cost(gnode *node1, gnode *node2) {
+  if (node1->cost != node2->cost) {
+    return node1->cost > node2->cost;
+  }
+  return node1->id < node2->id;
+}
+
+/**
+ * Stores an item in a position of the heap and updates its index.
+ *
+ * @param heap: heap
+ * @param item: item
+ * @param position: position
+ */
+void place_item(heap *heap, gnode *item, int position) {
+  heap->items[position] = item;
+  heap->positions[item->id] = position;
+}
+
+/**
+ * Moves an item up the heap until its parent comes before it.
+ *
+ * @param heap: heap
+ * @param position: current position of the item
+ */
+void sift_up(heap *heap, int position) {
+  gnode *item = heap->items[position];
+  while (position > 0) {
+    int parent = (position - 1) / 2;
+    if (!heap->comes_first(item, heap->items[parent])) {
+      break;
+    }
+    place_item(heap, heap->items[parent], position);
+    position = parent;
+  }
+  place_item(heap, item, position);
+}
+
+/**
+ * Moves an item down the heap until it comes before its children.
+ *
+ * @param heap: heap
+ * @param position: current position of the item
+ */
+void sift_down(heap *heap, int position) {
+  gnode *item = heap->items[position];
+  while (true) {
+    int child = 2 * position + 1;
+    if (child >= heap->size) {
+      break;
+    }
+    if (child + 1 < heap->size &&
+        heap->comes_first(heap->items[child + 1], heap->items[child])) {
+      child++;
+    }
+    if (!heap->comes_first(heap->items[child], item)) {
+      break;
+    }
+    place_item(heap, heap->items[child], position);
+    position = child;
+  }
+  place_item(heap, item, position);
+}
@@ -8,20 +8,105 @@
 
 #include "graph.h"
 
+// Returns whether node1 must come out of the heap before node2
+typedef bool (*heap_comparator)(gnode *node1, gnode *node2);
+
+// Indexed binary heap of graph nodes. The position of each node in the heap
+// is indexed by the node id, so a node can be found, removed or have its key
+// changed in logarithmic time.
 typedef struct Heap {
-  gnode** items;
+  gnode **items;
+  int *positions; // Position of each node id in items (-1 if not in the heap)
   int size;
-  bool min;
+  int max_size;
+  heap_comparator comes_first;
 } heap;
 
-heap * create_empty_heap(int max_size, bool min);
+/**
+ * Creates an empty heap.
+ *
+ * @param max_size: nodes in the heap have ids from 0 to max_size - 1
+ * @param comes_first: order of the nodes in the heap
+ *
+ * @return New heap
+ */
+heap *create_empty_heap(int max_size, heap_comparator comes_first);
 
-void add_to_heap(gnode* elto, heap * heap);
+/**
+ * Adds a node to a heap. Nothing is done if the node is already in the heap.
+ *
+ * @param elto: node
+ * @param heap: heap
+ */
+void add_to_heap(gnode *elto, heap *heap);
 
-void build_heap(heap * heap);
+/**
+ * Removes a node from a heap. Nothing is done if the node is not in the heap.
+ *
+ * @param elto: node
+ * @param heap: heap
+ */
+void remove_from_heap(gnode *elto, heap *heap);
 
-gnode* extract_heap_root(heap * heap);
+/**
+ * Checks whether a node is in a heap.
+ *
+ * @param elto: node
+ * @param heap: heap
+ *
+ * @return
+ */
+bool does_elto_belong_to_heap(gnode *elto, heap *heap);
+
+/**
+ * Moves a node towards the root of a heap after its key changed so that it
+ * comes out earlier.
+ *
+ * @param elto: node in the heap
+ * @param heap: heap
+ */
+void decrease_heap_key(gnode *elto, heap *heap);
+
+/**
+ * Moves a node towards the leaves of a heap after its key changed so that it
+ * comes out later.
+ *
+ * @param elto: node in the heap
+ * @param heap: heap
+ */
+void increase_heap_key(gnode *elto, heap *heap);
+
+/**
+ * Removes the root of a heap.
+ *
+ * @param heap: heap
+ *
+ * @return Root of the heap or NULL if it is empty.
+ */
+gnode *extract_heap_root(heap *heap);
+
+/**
+ * Gets the root of a heap without removing it.
+ *
+ * @param heap: heap
+ *
+ * @return Root of the heap or NULL if it is empty.
+ */
+gnode *peek_heap_root(heap *heap);
+
+/**
+ * Frees the memory allocated to a heap. The nodes are not freed.
+ *
+ * @param heap: heap
+ */
+void free_heap(heap *heap);
+
+/**
+ * Comparators to build heaps of nodes with the lowest (highest) cost at the
+ * root. Ties are broken by the smallest id.
+ */
+bool has_lower_cost(gnode *node1, gnode *node2);
 
-gnode* peek_heap_root(heap * heap);
+bool has_higher_cost(gnode *node1, gnode *node2);
 
 #endif
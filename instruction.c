@@ -205,3 +205,41 @@ bool is_rhs_variable(inode *instruction) {
   return SRC1(instruction) && instruction->op_type != OP_Call &&
          instruction->op_type != OP_Enter && instruction->op_type != OP_Global;
 }
+
+void update_def_and_use_ids(inode *instruction) {
+  symtabnode *vars[3] = {NULL, NULL, NULL};
+  instruction->def_id = -1;
+  instruction->num_uses = 0;
+  instruction->num_value_uses = 0;
+
+  if (instruction->dest && instruction->dest->scope == Local) {
+    if (instruction->dest->type == t_Addr) {
+      vars[0] = instruction->dest;
+    } else {
+      instruction->def_id = instruction->dest->id;
+    }
+  }
+
+  if (is_rhs_variable(instruction)) {
+    if (SRC1(instruction) && SRC1(instruction)->scope == Local &&
+        !SRC1(instruction)->is_constant) {
+      vars[1] = SRC1(instruction);
+    }
+    if (SRC2(instruction) && SRC2(instruction)->scope == Local &&
+        !SRC2(instruction)->is_constant) {
+      vars[2] = SRC2(instruction);
+    }
+  }
+
+  for (int i = 1; i < 3; i++) {
+    if (vars[i] && vars[i]->type != t_Addr) {
+      instruction->use_ids[instruction->num_uses++] = vars[i]->id;
+    }
+  }
+  instruction->num_value_uses = instruction->num_uses;
+  for (int i = 0; i < 3; i++) {
+    if (vars[i] && vars[i]->type == t_Addr) {
+      instruction->use_ids[instruction->num_uses++] = vars[i]->id;
+    }
+  }
+}
@@ -65,6 +65,14 @@ typedef struct Instruction {
   bool dead;
   set live_at_call; // Set of live variables at the call instruction
 
+  // Ids of the local variables defined and used by the instruction (see
+  // update_def_and_use_ids). Uses of variables of type t_Addr come after the
+  // other uses.
+  int def_id; // -1 if no local variable is defined
+  int use_ids[3];
+  int num_uses;
+  int num_value_uses; // Number of uses of variables not of type t_Addr
+
 } inode;
 
 static int label_counter = 0;
@@ -151,6 +159,32 @@ void print_instruction(inode *instruction, FILE* file);
  *                                                                   *
  *********************************************************************/
 
+/**
+ * Iterates over the instructions of a block, from its first to its last
+ * instruction. Dead instructions are included.
+ *
+ * @param instruction: name of the inode* variable that receives each
+ * instruction
+ * @param block: block
+ */
+#define FOR_EACH_INSTRUCTION_IN_BLOCK(instruction, block)                      \
+  for (inode *instruction = (block)->first_instruction;                        \
+       instruction != (block)->last_instruction->next;                         \
+       instruction = instruction->next)
+
+/**
+ * Iterates over the instructions of a block, from its last to its first
+ * instruction. Dead instructions are included.
+ *
+ * @param instruction: name of the inode* variable that receives each
+ * instruction
+ * @param block: block
+ */
+#define FOR_EACH_INSTRUCTION_IN_BLOCK_REVERSE(instruction, block)              \
+  for (inode *instruction = (block)->last_instruction;                         \
+       instruction != (block)->first_instruction->previous;                    \
+       instruction = instruction->previous)
+
 /**
  * Connects a subsequent instruction to its predecessor.
  *
@@ -179,4 +213,15 @@ bool redefines_variable(inode* instruction);
  */
 bool is_rhs_variable();
 
+/**
+ * Computes the ids of the local variables defined and used by an instruction.
+ * Globals and constants are ignored. When the destination of the instruction
+ * is of type t_Addr, it is considered used rather than defined, as it holds the
+ * address of the memory effectively changed. It must be called again whenever
+ * the operands of the instruction change.
+ *
+ * @param instruction: instruction
+ */
+void update_def_and_use_ids(inode *instruction);
+
 #endif // CSC553_INSTRUCTION_H
@@ -0,0 +1,239 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#include "linear_scan.h"
+#include "code_optimization.h"
+#include <limits.h>
+
+// Interval of positions where a node is live. Each instruction has two
+// positions: one where its operands are read and, right after it, one where
+// its result is written. Intervals that end where another starts can share a
+// register.
+typedef struct LiveInterval {
+  gnode *node;
+  int start;
+  int end;
+} live_interval;
+
+static live_interval *find_live_intervals(graph *graph, int *num_intervals);
+static void extend_interval(live_interval *interval, int position);
+static int compare_intervals(const void *interval1, const void *interval2);
+static int choose_register(gnode *node, set free_regs);
+static int find_interval_to_spill(live_interval *current,
+                                  live_interval **active, int num_active);
+static void add_to_active(live_interval *interval, live_interval **active,
+                          int num_active);
+
+void allocate_registers_by_linear_scan(graph *graph, int num_registers) {
+  int num_intervals;
+  live_interval *intervals = find_live_intervals(graph, &num_intervals);
+  qsort(intervals, num_intervals, sizeof(live_interval), compare_intervals);
+
+  // Intervals currently in a register, by increasing end
+  live_interval **active =
+      zalloc((num_registers + 1) * sizeof(live_interval *));
+  int num_active = 0;
+  set free_regs = create_full_set(num_registers);
+
+  for (int i = 0; i < num_intervals; i++) {
+    live_interval *current = &intervals[i];
+
+    // Release the registers of the intervals that ended
+    int num_expired = 0;
+    while (num_expired < num_active &&
+           active[num_expired]->end < current->start) {
+      add_to_set(active[num_expired]->node->reg, free_regs);
+      num_expired++;
+    }
+    num_active -= num_expired;
+    memmove(active, active + num_expired, num_active * sizeof(live_interval *));
+
+    if (num_active < num_registers) {
+      current->node->reg = choose_register(current->node, free_regs);
+      remove_from_set(current->node->reg, free_regs);
+      add_to_active(current, active, num_active++);
+      continue;
+    }
+
+    int spilled = find_interval_to_spill(current, active, num_active);
+    if (spilled >= 0) {
+      // The current interval takes the register of the spilled one
+      current->node->reg = active[spilled]->node->reg;
+      active[spilled]->node->reg = -1;
+      num_active--;
+      memmove(active + spilled, active + spilled + 1,
+              (num_active - spilled) * sizeof(live_interval *));
+      add_to_active(current, active, num_active++);
+    } else {
+      current->node->reg = -1;
+    }
+  }
+
+  free_set(free_regs);
+  free(active);
+  free(intervals);
+}
+
+/**
+ * Computes the live interval of each node of a graph. Blocks are contiguous in
+ * the order of the instructions, so a node is live from the entry (exit) of
+ * the blocks where it is live in (out), and wherever it is defined or used.
+ *
+ * @param graph: graph
+ * @param num_intervals: receives the number of intervals
+ *
+ * @return Array of intervals of the nodes.
+ */
+live_interval *find_live_intervals(graph *graph, int *num_intervals) {
+  live_interval *intervals =
+      zalloc((graph->max_nodes + 1) * sizeof(live_interval));
+  for (int id = 0; id < graph->max_nodes; id++) {
+    intervals[id].node = graph->nodes[id];
+    intervals[id].start = INT_MAX;
+    intervals[id].end = -1;
+  }
+
+  bnode **blocks = get_all_blocks();
+  for (int i = 0; i < get_num_created_blocks(); i++) {
+    bnode *block = blocks[i];
+    int first = 2 * block->first_instruction->order;
+    int last = 2 * block->last_instruction->order + 1;
+    FOR_EACH_ELTO_IN_SET(id, block->in) {
+      extend_interval(&intervals[id], first);
+    }
+    FOR_EACH_ELTO_IN_SET(id, block->out) {
+      extend_interval(&intervals[id], last);
+    }
+
+    FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, block) {
+      if (curr_instruction->dead) {
+        continue;
+      }
+
+      int position = 2 * curr_instruction->order;
+      for (int j = 0; j < curr_instruction->num_value_uses; j++) {
+        extend_interval(&intervals[curr_instruction->use_ids[j]], position);
+      }
+      if (curr_instruction->def_id >= 0) {
+        extend_interval(&intervals[curr_instruction->def_id], position + 1);
+      }
+      if (curr_instruction->op_type == OP_Enter) {
+        // The formals in registers are loaded from the stack at the entry
+        for (int id = 0; id < graph->max_nodes; id++) {
+          if (graph->nodes[id] && get_variable_by_id(id)->formal) {
+            extend_interval(&intervals[id], position + 1);
+          }
+        }
+      }
+    }
+  }
+
+  // Keep only the nodes that are live somewhere
+  *num_intervals = 0;
+  for (int id = 0; id < graph->max_nodes; id++) {
+    if (intervals[id].node && intervals[id].end >= 0) {
+      intervals[(*num_intervals)++] = intervals[id];
+    }
+  }
+
+  return intervals;
+}
+
+/**
+ * Extends an interval to include a position.
+ *
+ * @param interval: interval
+ * @param position: position
+ */
+void extend_interval(live_interval *interval, int position) {
+  if (position < interval->start) {
+    interval->start = position;
+  }
+  if (position > interval->end) {
+    interval->end = position;
+  }
+}
+
+/**
+ * Orders intervals by increasing start.
+ *
+ * @param interval1: pointer to an interval
+ * @param interval2: pointer to another interval
+ *
+ * @return Negative if the first interval comes first.
+ */
+int compare_intervals(const void *interval1, const void *interval2) {
+  const live_interval *i1 = interval1;
+  const live_interval *i2 = interval2;
+  if (i1->start != i2->start) {
+    return i1->start - i2->start;
+  }
+  return i1->node->id - i2->node->id;
+}
+
+/**
+ * Chooses a free register for a node, preferably one from its preferential
+ * list.
+ *
+ * @param node: node
+ * @param free_regs: free registers (not empty)
+ *
+ * @return Register
+ */
+int choose_register(gnode *node, set free_regs) {
+  FOR_EACH_ELTO_IN_SET(reg, free_regs) {
+    if (does_elto_belong_to_set(reg, node->preferential_regs)) {
+      return reg;
+    }
+  }
+  return get_next_elto_in_set(0, free_regs);
+}
+
+/**
+ * Chooses the interval to spill when all the registers are taken: the one
+ * with the lowest cost among the active intervals and the current one. Ties
+ * are broken by the furthest end, which frees the register for longer.
+ *
+ * @param current: interval that needs a register
+ * @param active: intervals in a register
+ * @param num_active: number of active intervals
+ *
+ * @return Index of the active interval to spill, or -1 to spill the current
+ * one.
+ */
+int find_interval_to_spill(live_interval *current, live_interval **active,
+                           int num_active) {
+  int spilled = -1;
+  long long lowest_cost = current->node->cost;
+  int furthest_end = current->end;
+  for (int i = 0; i < num_active; i++) {
+    long long cost = active[i]->node->cost;
+    if (cost < lowest_cost ||
+        (cost == lowest_cost && active[i]->end > furthest_end)) {
+      spilled = i;
+      lowest_cost = cost;
+      furthest_end = active[i]->end;
+    }
+  }
+  return spilled;
+}
+
+/**
+ * Inserts an interval in the list of active intervals, keeping it sorted by
+ * increasing end.
+ *
+ * @param interval: interval
+ * @param active: active intervals, with room for one more
+ * @param num_active: number of active intervals before the insertion
+ */
+void add_to_active(live_interval *interval, live_interval **active,
+                   int num_active) {
+  int i = num_active;
+  while (i > 0 && active[i - 1]->end > interval->end) {
+    active[i] = active[i - 1];
+    i--;
+  }
+  active[i] = interval;
+}
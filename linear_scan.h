@@ -0,0 +1,23 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#ifndef CSC553_LINEAR_SCAN_H
+#define CSC553_LINEAR_SCAN_H
+
+#include "control_flow.h"
+
+/**
+ * Allocates registers to the nodes of a graph by linear scan. The live
+ * interval of each node goes from the first to the last instruction, in the
+ * order of the instructions, where its variable is live. The edges of the
+ * graph are not used, so they do not need to be added. It requires the
+ * liveness in and out sets of the blocks.
+ *
+ * @param graph: graph with a node for each variable to allocate
+ * @param num_registers: number of registers available
+ */
+void allocate_registers_by_linear_scan(graph *graph, int num_registers);
+
+#endif // CSC553_LINEAR_SCAN_H
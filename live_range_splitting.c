@@ -0,0 +1,344 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#include "live_range_splitting.h"
+#include "liveness_analysis.h"
+
+// Reference to a variable in an operand of an instruction
+typedef struct Occurrence {
+  inode *instruction;
+  symtabnode **operand;
+  int element; // Element of the partition of definitions into webs
+} occurrence;
+
+// Partition of the definitions of the variables into webs. The elements are
+// the definitions in the instructions and, for each block, the definitions
+// of the variables live at its entry that reach it.
+typedef struct WebPartition {
+  int *parents; // Union-find forest
+  int num_elements;
+  int capacity;
+  int *entry_offsets;  // Start of the entries of each block, indexed by id
+  int *entry_ids;      // Ids of the variables live at the entry of each block,
+                       // in the ascending order of the set
+  int *entry_elements; // Element of each of those entries, or -1
+  int num_variables;
+} web_partition;
+
+static void find_occurrences(bnode *block, web_partition *partition,
+                             int *current_elements);
+static void add_occurrence(inode *instruction, symtabnode **operand,
+                           int element);
+static int create_element(web_partition *partition);
+static int get_entry_element(web_partition *partition, bnode *block, int id);
+static void create_entry_elements(web_partition *partition, bnode **blocks,
+                                  int num_blocks);
+static int find_web(web_partition *partition, int element);
+static void unite_webs(web_partition *partition, int element1, int element2);
+static void rename_webs(web_partition *partition);
+static bool is_null_assignment(inode *instruction);
+static bool can_be_split(symtabnode *var);
+
+static occurrence *occurrences = NULL;
+static int num_occurrences = 0;
+static int occurrences_capacity = 0;
+
+bool is_allocation_candidate(symtabnode *var) {
+  // This optimization is not carried out for arrays. Formals of type t_Array
+  // hold the address of the array.
+  return var && var->scope == Local && !var->is_constant &&
+         var->type != t_Array && var->type != t_Addr;
+}
+
+void split_live_ranges() {
+  find_in_and_out_liveness_sets();
+
+  int num_blocks = get_num_created_blocks();
+  web_partition partition;
+  partition.num_variables = get_total_local_variables();
+  partition.num_elements = 0;
+  partition.capacity = 0;
+  partition.parents = NULL;
+  bnode **blocks = get_all_blocks();
+  create_entry_elements(&partition, blocks, num_blocks);
+  num_occurrences = 0;
+
+  int *current_elements = zalloc((partition.num_variables + 1) * sizeof(int));
+  for (int id = 0; id < partition.num_variables; id++) {
+    current_elements[id] = -1;
+  }
+  for (int id = 0; id < num_blocks; id++) {
+    find_occurrences(blocks[id], &partition, current_elements);
+  }
+  rename_webs(&partition);
+
+  free(current_elements);
+  free(partition.entry_offsets);
+  free(partition.entry_ids);
+  free(partition.entry_elements);
+  free(partition.parents);
+}
+
+/**
+ * Lays out the entries of the variables live at the entry of each block. Only
+ * those variables get an entry, as most of them are dead in most blocks.
+ *
+ * @param partition: partition of the definitions into webs
+ * @param blocks: all the blocks, indexed by id
+ * @param num_blocks: number of blocks
+ */
+void create_entry_elements(web_partition *partition, bnode **blocks,
+                           int num_blocks) {
+  partition->entry_offsets = zalloc((num_blocks + 1) * sizeof(int));
+  int num_entries = 0;
+  for (int id = 0; id < num_blocks; id++) {
+    partition->entry_offsets[id] = num_entries;
+    num_entries += get_set_size(blocks[id]->in);
+  }
+  partition->entry_offsets[num_blocks] = num_entries;
+
+  partition->entry_ids = zalloc((num_entries + 1) * sizeof(int));
+  partition->entry_elements = zalloc((num_entries + 1) * sizeof(int));
+  for (int id = 0; id < num_blocks; id++) {
+    int index = partition->entry_offsets[id];
+    FOR_EACH_ELTO_IN_SET(var_id, blocks[id]->in) {
+      partition->entry_ids[index] = var_id;
+      partition->entry_elements[index] = -1;
+      index++;
+    }
+  }
+}
+
+/**
+ * Records the references to the variables in a block along with the element
+ * of the definitions reaching them, and connects the definitions live at the
+ * exit of the block to the ones live at the entry of its successors.
+ *
+ * @param block: block
+ * @param partition: partition of the definitions into webs
+ * @param current_elements: scratch array indexed by variable id, with all of
+ * its entries set to -1
+ */
+void find_occurrences(bnode *block, web_partition *partition,
+                      int *current_elements) {
+  FOR_EACH_ELTO_IN_SET(id, block->in) {
+    current_elements[id] = get_entry_element(partition, block, id);
+  }
+
+  FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, block) {
+    if (curr_instruction->dead || is_null_assignment(curr_instruction)) {
+      // Null assignments are ignored by the liveness analysis as well
+      continue;
+    }
+
+    if (is_rhs_variable(curr_instruction)) {
+      symtabnode **operands[2] = {&SRC1(curr_instruction),
+                                  &SRC2(curr_instruction)};
+      for (int i = 0; i < 2; i++) {
+        symtabnode *var = *operands[i];
+        if (can_be_split(var)) {
+          if (current_elements[var->id] < 0) {
+            // Use of an uninitialized variable
+            current_elements[var->id] = create_element(partition);
+          }
+          add_occurrence(curr_instruction, operands[i],
+                         current_elements[var->id]);
+        }
+      }
+    }
+
+    if (curr_instruction->def_id >= 0 &&
+        can_be_split(curr_instruction->dest)) {
+      int element = create_element(partition);
+      current_elements[curr_instruction->def_id] = element;
+      add_occurrence(curr_instruction, &curr_instruction->dest, element);
+    }
+  }
+
+  FOR_EACH_ELTO_IN_SET(id, block->out) {
+    if (current_elements[id] < 0) {
+      continue;
+    }
+    for (int i = 0; i < block->num_successors; i++) {
+      bnode *successor = block->successors[i];
+      if (does_elto_belong_to_set(id, successor->in)) {
+        unite_webs(partition, current_elements[id],
+                   get_entry_element(partition, successor, id));
+      }
+    }
+  }
+
+  // Clears only the entries set in this block, so that the scratch array
+  // costs nothing for the variables the block does not reference
+  FOR_EACH_ELTO_IN_SET(id, block->in) { current_elements[id] = -1; }
+  FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, block) {
+    if (is_rhs_variable(curr_instruction)) {
+      if (can_be_split(SRC1(curr_instruction))) {
+        current_elements[SRC1(curr_instruction)->id] = -1;
+      }
+      if (can_be_split(SRC2(curr_instruction))) {
+        current_elements[SRC2(curr_instruction)->id] = -1;
+      }
+    }
+    if (curr_instruction->def_id >= 0) {
+      current_elements[curr_instruction->def_id] = -1;
+    }
+  }
+}
+
+/**
+ * Appends a reference to a variable to the list of occurrences.
+ *
+ * @param instruction: instruction
+ * @param operand: operand of the instruction that references the variable
+ * @param element: element of the definitions reaching the reference
+ */
+void add_occurrence(inode *instruction, symtabnode **operand, int element) {
+  if (num_occurrences == occurrences_capacity) {
+    occurrences_capacity = occurrences_capacity ? 2 * occurrences_capacity : 64;
+    occurrences =
+        realloc(occurrences, occurrences_capacity * sizeof(occurrence));
+  }
+  occurrences[num_occurrences].instruction = instruction;
+  occurrences[num_occurrences].operand = operand;
+  occurrences[num_occurrences].element = element;
+  num_occurrences++;
+}
+
+/**
+ * Adds a new element to the partition, in a web of its own.
+ *
+ * @param partition: partition of the definitions into webs
+ *
+ * @return New element
+ */
+int create_element(web_partition *partition) {
+  if (partition->num_elements == partition->capacity) {
+    partition->capacity = partition->capacity ? 2 * partition->capacity : 64;
+    partition->parents =
+        realloc(partition->parents, partition->capacity * sizeof(int));
+  }
+  partition->parents[partition->num_elements] = partition->num_elements;
+  return partition->num_elements++;
+}
+
+/**
+ * Gets the element of the definitions of a variable live at the entry of a
+ * block, creating it if needed.
+ *
+ * @param partition: partition of the definitions into webs
+ * @param block: block
+ * @param id: id of the variable
+ *
+ * @return Element
+ */
+int get_entry_element(web_partition *partition, bnode *block, int id) {
+  // The ids of the block are sorted, and the variable is live at its entry
+  int low = partition->entry_offsets[block->id];
+  int high = partition->entry_offsets[block->id + 1] - 1;
+  while (low < high) {
+    int middle = low + (high - low) / 2;
+    if (partition->entry_ids[middle] < id) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  int index = low;
+  if (partition->entry_elements[index] < 0) {
+    partition->entry_elements[index] = create_element(partition);
+  }
+  return partition->entry_elements[index];
+}
+
+/**
+ * Finds the representative element of the web of an element.
+ *
+ * @param partition: partition of the definitions into webs
+ * @param element: element
+ *
+ * @return Representative element
+ */
+int find_web(web_partition *partition, int element) {
+  while (partition->parents[element] != element) {
+    // Path halving
+    partition->parents[element] =
+        partition->parents[partition->parents[element]];
+    element = partition->parents[element];
+  }
+  return element;
+}
+
+/**
+ * Merges the webs of two elements.
+ *
+ * @param partition: partition of the definitions into webs
+ * @param element1: element1
+ * @param element2: element2
+ */
+void unite_webs(web_partition *partition, int element1, int element2) {
+  int web1 = find_web(partition, element1);
+  int web2 = find_web(partition, element2);
+  if (web1 != web2) {
+    partition->parents[web2] = web1;
+  }
+}
+
+/**
+ * Renames the references to the variables in every web but the first of each
+ * variable to a new variable.
+ *
+ * @param partition: partition of the definitions into webs
+ */
+void rename_webs(web_partition *partition) {
+  // Variable of each web (NULL if not seen yet)
+  symtabnode **web_variables =
+      zalloc((partition->num_elements + 1) * sizeof(symtabnode *));
+  // Number of webs of each variable
+  int *num_webs = zalloc((partition->num_variables + 1) * sizeof(int));
+
+  for (int i = 0; i < num_occurrences; i++) {
+    symtabnode *var = *occurrences[i].operand;
+    int web = find_web(partition, occurrences[i].element);
+    if (!web_variables[web]) {
+      web_variables[web] = num_webs[var->id] == 0
+                               ? var
+                               : create_split_variable(var, num_webs[var->id]);
+      num_webs[var->id]++;
+    }
+    *occurrences[i].operand = web_variables[web];
+  }
+
+  for (int i = 0; i < num_occurrences; i++) {
+    update_def_and_use_ids(occurrences[i].instruction);
+  }
+
+  free(web_variables);
+  free(num_webs);
+}
+
+/**
+ * Checks whether an instruction assigns a variable to itself.
+ *
+ * @param instruction: instruction
+ *
+ * @return
+ */
+bool is_null_assignment(inode *instruction) {
+  return instruction->op_type == OP_Assign &&
+         instruction->dest == SRC1(instruction);
+}
+
+/**
+ * Checks whether a variable can be split into webs. The value of a formal at
+ * the entry of the function is in its stack slot, so formals are never split.
+ *
+ * @param var: symbol table entry (possibly NULL)
+ *
+ * @return
+ */
+bool can_be_split(symtabnode *var) {
+  return is_allocation_candidate(var) && !var->formal;
+}
@@ -0,0 +1,32 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#ifndef CSC553_LIVE_RANGE_SPLITTING_H
+#define CSC553_LIVE_RANGE_SPLITTING_H
+
+#include "control_flow.h"
+
+/**
+ * Checks whether a variable can be allocated to a register.
+ *
+ * @param var: symbol table entry
+ *
+ * @return
+ */
+bool is_allocation_candidate(symtabnode *var);
+
+/**
+ * Splits each variable that can be allocated to a register, except for the
+ * formals, into its webs. A
+ * web is a maximal set of definitions and uses of a variable connected by the
+ * definitions reaching each use. The first web keeps the variable and each
+ * other web is renamed to a new variable, so that they get their own node in
+ * the interference graph. The live ranges of a variable found by the liveness
+ * analysis are the same as the ones of its webs, so the in and out sets of the
+ * blocks must be computed again afterwards.
+ */
+void split_live_ranges();
+
+#endif // CSC553_LIVE_RANGE_SPLITTING_H
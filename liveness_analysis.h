@@ -6,14 +6,30 @@
 #ifndef CSC553_REACHING_DEFINITIONS_ANALYSIS_H
 #define CSC553_REACHING_DEFINITIONS_ANALYSIS_H
 
-#include "control_flow.h"
+#include "dataflow.h"
 
 /**
  * Iteratively computes def and use sets for each block of a control flow
  * graph.
+ */
+void find_in_and_out_liveness_sets();
+
+/**
+ * Creates and solves the liveness problem of a control flow graph, without
+ * storing its in and out sets in the blocks. It can be kept up to date while
+ * instructions are removed.
+ *
+ * @return Solved liveness problem
+ */
+df_problem* create_liveness_problem();
+
+/**
+ * Updates a solved liveness problem after instructions of some blocks were
+ * removed. Only the affected blocks are recomputed.
  *
- * @param block_list_head: first block in a list of blocks
+ * @param problem: solved liveness problem
+ * @param changed_blocks: ids of the blocks with removed instructions
  */
-void find_in_and_out_liveness_sets(blist_node* block_list_head);
+void update_liveness_problem(df_problem* problem, set changed_blocks);
 
 #endif // CSC553_REACHING_DEFINITIONS_ANALYSIS_H
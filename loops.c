@@ -0,0 +1,233 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#include "loops.h"
+#include <stdlib.h>
+
+static int LOOP_ITERATIONS = 10; // Assumed number of iterations of a loop
+static int MAX_FREQUENCY_DEPTH = 9; // Deeper loops do not increase frequency
+
+static llist_node *all_loops = NULL;
+
+static void clear_loops();
+static loop *find_loop_body(bnode *header, bnode *tail, loop *existing_loop);
+static int compare_loops_by_size(const void *loop1, const void *loop2);
+static void find_exits_and_preheader(loop *loop);
+static llist_node *add_to_list_of_loops(loop *curr_loop,
+                                        llist_node *list_head);
+
+void find_loops() {
+  clear_loops();
+
+  int n = get_num_created_blocks();
+  bnode **blocks = get_all_blocks();
+  loop **loop_per_header = zalloc(n * sizeof(loop *));
+  int num_loops = 0;
+
+  // Natural loops from back edges
+  for (int id = 0; id < n; id++) {
+    bnode *block = blocks[id];
+    block->loop = NULL;
+    for (int i = 0; i < block->num_successors; i++) {
+      bnode *child = block->successors[i];
+      if (dominates(child, block)) {
+        loop *existing_loop = loop_per_header[child->id];
+        loop_per_header[child->id] =
+            find_loop_body(child, block, existing_loop);
+        if (!existing_loop) {
+          num_loops++;
+        }
+      }
+    }
+  }
+
+  if (num_loops == 0) {
+    free(loop_per_header);
+    return;
+  }
+
+  // Larger loops are processed first, so a loop is always processed after
+  // the ones that contain it and each block ends up associated with the
+  // innermost loop.
+  loop **loops = zalloc(num_loops * sizeof(loop *));
+  int i = 0;
+  for (int id = 0; id < n; id++) {
+    if (loop_per_header[id]) {
+      loops[i++] = loop_per_header[id];
+    }
+  }
+  qsort(loops, num_loops, sizeof(loop *), compare_loops_by_size);
+
+  for (i = 0; i < num_loops; i++) {
+    loop *curr_loop = loops[i];
+    curr_loop->parent = curr_loop->header->loop;
+    if (curr_loop->parent) {
+      curr_loop->depth = curr_loop->parent->depth + 1;
+      curr_loop->parent->children =
+          add_to_list_of_loops(curr_loop, curr_loop->parent->children);
+    } else {
+      curr_loop->depth = 1;
+    }
+
+    FOR_EACH_ELTO_IN_SET(id, curr_loop->blocks) {
+      blocks[id]->loop = curr_loop;
+    }
+    find_exits_and_preheader(curr_loop);
+  }
+
+  for (i = num_loops - 1; i >= 0; i--) {
+    all_loops = add_to_list_of_loops(loops[i], all_loops);
+  }
+
+  free(loops);
+  free(loop_per_header);
+}
+
+/**
+ * Adds to a loop the blocks that reach the source of one of its back edges
+ * without going through its header.
+ *
+ * @param header: header of the loop
+ * @param tail: source of the back edge
+ * @param existing_loop: loop previously found with the same header, if any
+ *
+ * @return Loop
+ */
+loop *find_loop_body(bnode *header, bnode *tail, loop *existing_loop) {
+  loop *curr_loop = existing_loop;
+  if (!curr_loop) {
+    curr_loop = zalloc(sizeof(loop));
+    curr_loop->header = header;
+    curr_loop->blocks = create_empty_set(get_num_created_blocks());
+    add_to_set(header->id, curr_loop->blocks);
+  }
+
+  bnode **stack = zalloc(get_num_created_blocks() * sizeof(bnode *));
+  int top = -1;
+  if (!does_elto_belong_to_set(tail->id, curr_loop->blocks)) {
+    add_to_set(tail->id, curr_loop->blocks);
+    stack[++top] = tail;
+  }
+  while (top >= 0) {
+    bnode *block = stack[top--];
+    for (int i = 0; i < block->num_predecessors; i++) {
+      bnode *parent = block->predecessors[i];
+      if (!does_elto_belong_to_set(parent->id, curr_loop->blocks)) {
+        add_to_set(parent->id, curr_loop->blocks);
+        stack[++top] = parent;
+      }
+    }
+  }
+  free(stack);
+
+  return curr_loop;
+}
+
+/**
+ * Orders loops by decreasing number of blocks.
+ */
+int compare_loops_by_size(const void *loop1, const void *loop2) {
+  int size1 = get_set_size((*(loop **)loop1)->blocks);
+  int size2 = get_set_size((*(loop **)loop2)->blocks);
+  return size2 - size1;
+}
+
+/**
+ * Finds the blocks where the execution continues after leaving a loop and the
+ * preheader of the loop, if there is one.
+ *
+ * @param curr_loop: loop
+ */
+void find_exits_and_preheader(loop *curr_loop) {
+  bnode **blocks = get_all_blocks();
+  set exits = create_empty_set(get_num_created_blocks());
+  FOR_EACH_ELTO_IN_SET(id, curr_loop->blocks) {
+    for (int i = 0; i < blocks[id]->num_successors; i++) {
+      bnode *child = blocks[id]->successors[i];
+      if (!does_elto_belong_to_set(child->id, curr_loop->blocks) &&
+          !does_elto_belong_to_set(child->id, exits)) {
+        add_to_set(child->id, exits);
+        blist_node *exit_node = zalloc(sizeof(blist_node));
+        exit_node->block = child;
+        exit_node->next = curr_loop->exits;
+        curr_loop->exits = exit_node;
+      }
+    }
+  }
+  free_set(exits);
+
+  bnode *entering_block = NULL;
+  int num_entering_blocks = 0;
+  bnode *header = curr_loop->header;
+  for (int i = 0; i < header->num_predecessors; i++) {
+    if (!does_elto_belong_to_set(header->predecessors[i]->id,
+                                 curr_loop->blocks)) {
+      entering_block = header->predecessors[i];
+      num_entering_blocks++;
+    }
+  }
+  if (num_entering_blocks == 1 && entering_block->num_successors == 1) {
+    curr_loop->preheader = entering_block;
+  }
+}
+
+/**
+ * Adds a loop to the beginning of a list of loops.
+ *
+ * @param curr_loop: loop
+ * @param list_head: first node of the list
+ *
+ * @return New list head
+ */
+llist_node *add_to_list_of_loops(loop *curr_loop, llist_node *list_head) {
+  llist_node *loop_node = zalloc(sizeof(llist_node));
+  loop_node->loop = curr_loop;
+  loop_node->next = list_head;
+  return loop_node;
+}
+
+/**
+ * Releases the memory used by the loops found in a previous function.
+ */
+void clear_loops() {
+  while (all_loops) {
+    loop *curr_loop = all_loops->loop;
+    free_set(curr_loop->blocks);
+    while (curr_loop->exits) {
+      blist_node *next = curr_loop->exits->next;
+      free(curr_loop->exits);
+      curr_loop->exits = next;
+    }
+    while (curr_loop->children) {
+      llist_node *next = curr_loop->children->next;
+      free(curr_loop->children);
+      curr_loop->children = next;
+    }
+    free(curr_loop);
+
+    llist_node *next = all_loops->next;
+    free(all_loops);
+    all_loops = next;
+  }
+}
+
+llist_node *get_all_loops() { return all_loops; }
+
+int get_loop_depth(bnode *block) {
+  return block->loop ? block->loop->depth : 0;
+}
+
+long long estimate_block_frequency(bnode *block) {
+  int depth = get_loop_depth(block);
+  if (depth > MAX_FREQUENCY_DEPTH) {
+    depth = MAX_FREQUENCY_DEPTH;
+  }
+
+  long long frequency = 1;
+  for (int i = 0; i < depth; i++) {
+    frequency *= LOOP_ITERATIONS;
+  }
+  return frequency;
+}
@@ -0,0 +1,68 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#ifndef CSC553_LOOPS_H
+#define CSC553_LOOPS_H
+
+#include "control_flow.h"
+
+struct LoopListNode;
+
+// Natural loop of the control flow graph. Loops with the same header are
+// merged into a single one.
+typedef struct Loop {
+  bnode *header;
+  set blocks; // Ids of the blocks in the loop, including the nested loops
+  blist_node *exits; // Blocks outside the loop reached from inside it
+  bnode *preheader; // Only predecessor of the header outside the loop if its
+                    // only successor is the header. NULL otherwise.
+  int depth; // 1 for outermost loops
+
+  // Loop nesting forest
+  struct Loop *parent; // Innermost loop that contains this one
+  struct LoopListNode *children;
+} loop;
+
+typedef struct LoopListNode {
+  loop *loop;
+  struct LoopListNode *next;
+} llist_node;
+
+/**
+ * Finds the natural loops of the control flow graph from its back edges
+ * (edges whose target dominates their source) and organizes them in a loop
+ * nesting forest. Each block is associated with the innermost loop that
+ * contains it.
+ */
+void find_loops();
+
+/**
+ * Gets the list of all loops found. A loop always comes after the loops that
+ * contain it.
+ *
+ * @return Loop list head
+ */
+llist_node *get_all_loops();
+
+/**
+ * Gets the number of loops that contain a block.
+ *
+ * @param block: block
+ *
+ * @return Loop depth (0 if the block is not in a loop).
+ */
+int get_loop_depth(bnode *block);
+
+/**
+ * Estimates how many times a block executes per execution of the function,
+ * assuming every loop iterates a fixed number of times.
+ *
+ * @param block: block
+ *
+ * @return Estimated frequency
+ */
+long long estimate_block_frequency(bnode *block);
+
+#endif // CSC553_LOOPS_H
@@ -25,6 +25,12 @@ int main(int argc, char *argv[]) {
     } else if (strcmp("-Oregalloc", argv[i]) == 0) {
       enable_register_allocation_optimization();
       optimized = true;
+    } else if (strcmp("-Oregalloc=linear", argv[i]) == 0) {
+      enable_linear_scan_register_allocation();
+      optimized = true;
+    } else if (strcmp("-Oregargs", argv[i]) == 0) {
+      enable_register_arguments();
+      optimized = true;
     } else if (strcmp("-Odev", argv[i]) == 0) {
       dev = true;
     } else if (strcmp("-Otimer", argv[i]) == 0) {
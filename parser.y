@@ -21,7 +21,7 @@ extern void yyerror();
 extern void printSyntaxTree(tnode *t, int n, int depth);
 extern void process_function_header(symtabnode *func_header, tnode *body);
 extern void generate_function_code(symtabnode *func_header, tnode *body, int
-lr_type, int outer_scope_freq);
+lr_type);
 extern void process_allocations();
 extern void optimize_instructions(symtabnode *func_header, tnode *body);
 extern void print_instructions(tnode *t);
@@ -104,7 +104,7 @@ prog
 
 	   /* Code generation */
 	   process_function_header(currFun, currfnbodyTree);
-       generate_function_code(currFun, currfnbodyTree, 1, 1);
+       generate_function_code(currFun, currfnbodyTree, 1);
        process_allocations(currFun);
        optimize_instructions(currFun, currfnbodyTree);
        print_instructions(currfnbodyTree);
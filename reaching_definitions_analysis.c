@@ -5,144 +5,92 @@
 
 #include "reaching_definitions_analysis.h"
 
-static void find_gen_and_kill_sets(blist_node *block_list_head);
-static void fill_definitions(blist_node *block_list_head);
-static set get_out_set_from_predecessors(bnode *block);
-static void clear_gen_and_kill_sets(blist_node *block_list_head);
+static void find_gen_and_kill_sets(bnode *block, df_problem *problem);
+static void fill_definitions(bnode *block);
+static void store_reaching_sets(df_problem *problem);
 void clear_definitions_in_block(bnode *block);
 
-void find_in_and_out_def_sets(blist_node *block_list_head) {
-  find_gen_and_kill_sets(block_list_head);
-
-  bool converged = false;
-  while (!converged) {
-    converged = true;
-
-    blist_node *block_list_node = block_list_head;
-    while (block_list_node) {
-      set in = get_out_set_from_predecessors(block_list_node->block);
-      set diff = diff_sets(in, block_list_node->block->kill);
-      set out = unify_sets(block_list_node->block->gen, diff);
-
-      if (!are_set_equals(block_list_node->block->out, out)) {
-        block_list_node->block->out = out;
-        converged = false;
-      }
-      block_list_node = block_list_node->next;
-    }
+void find_in_and_out_def_sets() {
+  bnode **blocks = get_all_blocks();
+  int num_blocks = get_num_created_blocks();
+  for (int i = 0; i < num_blocks; i++) {
+    fill_definitions(blocks[i]);
   }
 
-  // No need to retain gen, kill and definitions after in and out were computed.
-  clear_gen_and_kill_sets(block_list_head);
-}
-
-/**
- * For each block, computes its gen and kill definition sets.
- *
- * @param root_block: first block of a function.
- */
-void find_gen_and_kill_sets(blist_node *block_list_head) {
-  fill_definitions(block_list_head);
-  blist_node *block_list_node = block_list_head;
-  int n = get_total_assignment_instructions();
-
-  while (block_list_node) {
-    set gen = create_empty_set(n);
-    set kill = create_empty_set(n);
-
-    inode *curr_instruction = block_list_node->block->first_instruction;
-    while (curr_instruction &&
-           curr_instruction->block == block_list_node->block) {
-      if (curr_instruction->dead) {
-        curr_instruction = curr_instruction->next;
-        continue;
-      }
-
-      if (redefines_variable(curr_instruction)) {
-        gen = diff_sets(gen, curr_instruction->dest->definitions);
-        add_to_set(curr_instruction->definition_id, gen);
-        kill = unify_sets(kill, curr_instruction->dest->definitions);
-        remove_from_set(curr_instruction->definition_id, kill);
-      }
-      curr_instruction = curr_instruction->next;
-    }
-
-    block_list_node->block->gen = gen;
-    block_list_node->block->kill = kill;
-    block_list_node->block->in = create_empty_set(n);
-    block_list_node->block->out = gen;
+  df_problem *problem =
+      create_dataflow_problem(DF_Forward, unify_sets_in_place,
+                              create_empty_set, create_empty_set,
+                              get_total_assignment_instructions());
+  for (int i = 0; i < num_blocks; i++) {
+    find_gen_and_kill_sets(blocks[i], problem);
+  }
+  solve_dataflow_problem(problem);
+  store_reaching_sets(problem);
+  free_dataflow_problem(problem);
 
-    block_list_node = block_list_node->next;
+  // No need to retain definitions after in and out were computed.
+  for (int i = 0; i < num_blocks; i++) {
+    clear_definitions_in_block(blocks[i]);
   }
 }
 
 /**
- * Fills the set of definitions among all instructions for each assigned
- * variable.
+ * Computes the gen and kill definition sets of a block.
  *
- * @param block_list_head: head of the list of blocks
+ * @param block: block
+ * @param problem: reaching definitions problem to store the sets
  */
-void fill_definitions(blist_node *block_list_head) {
-  blist_node *block_list_node = block_list_head;
+void find_gen_and_kill_sets(bnode *block, df_problem *problem) {
+  set gen = problem->gen[block->id];
+  set kill = problem->kill[block->id];
 
-  while (block_list_node) {
-    inode *curr_instruction = block_list_node->block->first_instruction;
-    while (curr_instruction &&
-           curr_instruction->block == block_list_node->block) {
-      if (redefines_variable(curr_instruction)) {
-        if (is_set_undefined(curr_instruction->dest->definitions)) {
-          curr_instruction->dest->definitions =
-              create_empty_set(get_total_assignment_instructions());
-        }
-        add_to_set(curr_instruction->definition_id,
-                   curr_instruction->dest->definitions);
-      }
-      curr_instruction = curr_instruction->next;
+  FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, block) {
+    if (curr_instruction->dead) {
+      continue;
     }
 
-    block_list_node = block_list_node->next;
+    if (redefines_variable(curr_instruction)) {
+      diff_sets_in_place(gen, curr_instruction->dest->definitions);
+      add_to_set(curr_instruction->definition_id, gen);
+      unify_sets_in_place(kill, curr_instruction->dest->definitions);
+      remove_from_set(curr_instruction->definition_id, kill);
+    }
   }
 }
 
 /**
- * Gets the union of all reaching variables in the end of the predecessors of
- * a block.
+ * Fills the set of definitions among all instructions for each variable
+ * assigned in a block.
  *
  * @param block: block
- *
- * @return: Union of predecessors' out set.
  */
-static set get_out_set_from_predecessors(bnode *block) {
-  if (!block->parents) {
-    // Empty set if no predecessors
-    return create_empty_set(block->gen.max_size);
-  }
-
-  blist_node *parent = block->parents;
-  set set = parent->block->out;
-  parent = parent->next;
-  while (parent) {
-    set = unify_sets(set, parent->block->out);
-    parent = parent->next;
+void fill_definitions(bnode *block) {
+  FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, block) {
+    if (redefines_variable(curr_instruction)) {
+      if (is_set_undefined(curr_instruction->dest->definitions)) {
+        curr_instruction->dest->definitions =
+            create_empty_set(get_total_assignment_instructions());
+      }
+      add_to_set(curr_instruction->definition_id,
+                 curr_instruction->dest->definitions);
+    }
   }
-
-  return set;
 }
 
 /**
- * For each block, erases its gen and kill sets.
+ * Moves the in and out sets of each block from the reaching definitions problem
+ * to the block.
  *
- * @param root_block: first block of a function.
+ * @param problem: solved reaching definitions problem
  */
-void clear_gen_and_kill_sets(blist_node *block_list_head) {
-  blist_node *block_list_node = block_list_head;
-  set null_set;
-
-  while (block_list_node) {
-    clear_definitions_in_block(block_list_node->block);
-    block_list_node->block->gen = null_set;
-    block_list_node->block->kill = null_set;
-    block_list_node = block_list_node->next;
+void store_reaching_sets(df_problem *problem) {
+  bnode **blocks = get_all_blocks();
+  for (int i = 0; i < get_num_created_blocks(); i++) {
+    // Sets from a previous analysis of the same function
+    free_set(blocks[i]->in);
+    free_set(blocks[i]->out);
+    blocks[i]->in = detach_dataflow_in_set(problem, i);
+    blocks[i]->out = detach_dataflow_out_set(problem, i);
   }
 }
 
@@ -152,12 +100,12 @@ void clear_gen_and_kill_sets(blist_node *block_list_head) {
  * @param block: block to scan.
  */
 void clear_definitions_in_block(bnode *block) {
-  set null_set;
-  inode *curr_instruction = block->first_instruction;
-  while (curr_instruction && curr_instruction->block == block) {
-    if (curr_instruction->dest) {
+  set null_set = {0};
+  FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, block) {
+    if (curr_instruction->dest &&
+        !is_set_undefined(curr_instruction->dest->definitions)) {
+      free_set(curr_instruction->dest->definitions);
       curr_instruction->dest->definitions = null_set;
     }
-    curr_instruction = curr_instruction->next;
   }
-}
\ No newline at end of file
+}
@@ -1,23 +1,461 @@
 #include "set.h"
 
 #include "global.h"
-#include <math.h>
 
-#define BYTES_PER_PARTITION 4
-#define BITS_PER_PARTITION 32
+#if defined(__x86_64__) || defined(__i386__)
+#define SET_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#define BITS_PER_WORD 64
+#define CACHE_LINE_SIZE 64
+#define WORDS_PER_CACHE_LINE 8 // 64-bit words in a cache line
+
+// Word-level kernels used by the set operations. The best implementation
+// supported by the CPU is chosen the first time a set is created. All of them
+// expect the number of words to be a multiple of WORDS_PER_CACHE_LINE and the
+// masks to be aligned to a cache line.
+typedef struct SetKernels {
+  bool (*unify)(uint64_t *target, const uint64_t *other, int num_words);
+  bool (*intersect)(uint64_t *target, const uint64_t *other, int num_words);
+  bool (*diff)(uint64_t *target, const uint64_t *other, int num_words);
+  bool (*transfer)(uint64_t *target, const uint64_t *gen,
+                   const uint64_t *source, const uint64_t *kill,
+                   int num_words);
+  bool (*equals)(const uint64_t *mask1, const uint64_t *mask2, int num_words);
+  bool (*empty)(const uint64_t *mask, int num_words);
+} set_kernels;
+
+static const set_kernels *kernels = NULL;
+
+static void select_kernels();
+
+/*********************************************************************
+ *                                                                   *
+ *                          Scalar kernels                           *
+ *                                                                   *
+ *********************************************************************/
+
+#define OR_WORDS(a, b) ((a) | (b))
+#define AND_WORDS(a, b) ((a) & (b))
+#define ANDNOT_WORDS(a, b) ((a) & ~(b))
+
+// In-place binary operation that reports whether the target changed
+#define SCALAR_BINARY_KERNEL(name, op)                                         \
+  static bool name(uint64_t *target, const uint64_t *other, int num_words) {   \
+    uint64_t changed = 0;                                                      \
+    for (int i = 0; i < num_words; i++) {                                      \
+      uint64_t new_word = op(target[i], other[i]);                             \
+      changed |= new_word ^ target[i];                                         \
+      target[i] = new_word;                                                    \
+    }                                                                          \
+    return changed != 0;                                                       \
+  }
+
+SCALAR_BINARY_KERNEL(unify_scalar, OR_WORDS)
+SCALAR_BINARY_KERNEL(intersect_scalar, AND_WORDS)
+SCALAR_BINARY_KERNEL(diff_scalar, ANDNOT_WORDS)
+
+static bool transfer_scalar(uint64_t *target, const uint64_t *gen,
+                            const uint64_t *source, const uint64_t *kill,
+                            int num_words) {
+  uint64_t changed = 0;
+  for (int i = 0; i < num_words; i++) {
+    uint64_t new_word = gen[i] | (source[i] & ~kill[i]);
+    changed |= new_word ^ target[i];
+    target[i] = new_word;
+  }
+  return changed != 0;
+}
+
+static bool equals_scalar(const uint64_t *mask1, const uint64_t *mask2,
+                          int num_words) {
+  for (int i = 0; i < num_words; i++) {
+    if (mask1[i] != mask2[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool empty_scalar(const uint64_t *mask, int num_words) {
+  for (int i = 0; i < num_words; i++) {
+    if (mask[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static const set_kernels scalar_kernels = {unify_scalar,    intersect_scalar,
+                                           diff_scalar,     transfer_scalar,
+                                           equals_scalar,   empty_scalar};
+
+#ifdef SET_X86_KERNELS
+
+/*********************************************************************
+ *                                                                   *
+ *                           SSE2 kernels                            *
+ *                                                                   *
+ *********************************************************************/
+
+// _mm_andnot_si128(a, b) computes ~a & b
+#define SSE2_ANDNOT(a, b) _mm_andnot_si128(b, a)
+
+#define SSE2_BINARY_KERNEL(name, op)                                           \
+  __attribute__((target("sse2"))) static bool name(                            \
+      uint64_t *target, const uint64_t *other, int num_words) {                \
+    __m128i changed = _mm_setzero_si128();                                     \
+    for (int i = 0; i < num_words; i += 2) {                                   \
+      __m128i t = _mm_load_si128((__m128i *)(target + i));                     \
+      __m128i o = _mm_load_si128((const __m128i *)(other + i));                \
+      __m128i new_words = op(t, o);                                            \
+      changed = _mm_or_si128(changed, _mm_xor_si128(new_words, t));            \
+      _mm_store_si128((__m128i *)(target + i), new_words);                     \
+    }                                                                          \
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(changed, _mm_setzero_si128())) !=  \
+           0xffff;                                                             \
+  }
+
+SSE2_BINARY_KERNEL(unify_sse2, _mm_or_si128)
+SSE2_BINARY_KERNEL(intersect_sse2, _mm_and_si128)
+SSE2_BINARY_KERNEL(diff_sse2, SSE2_ANDNOT)
+
+__attribute__((target("sse2"))) static bool
+transfer_sse2(uint64_t *target, const uint64_t *gen, const uint64_t *source,
+              const uint64_t *kill, int num_words) {
+  __m128i changed = _mm_setzero_si128();
+  for (int i = 0; i < num_words; i += 2) {
+    __m128i t = _mm_load_si128((__m128i *)(target + i));
+    __m128i g = _mm_load_si128((const __m128i *)(gen + i));
+    __m128i s = _mm_load_si128((const __m128i *)(source + i));
+    __m128i k = _mm_load_si128((const __m128i *)(kill + i));
+    __m128i new_words = _mm_or_si128(g, _mm_andnot_si128(k, s));
+    changed = _mm_or_si128(changed, _mm_xor_si128(new_words, t));
+    _mm_store_si128((__m128i *)(target + i), new_words);
+  }
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(changed, _mm_setzero_si128())) !=
+         0xffff;
+}
+
+__attribute__((target("sse2"))) static bool
+equals_sse2(const uint64_t *mask1, const uint64_t *mask2, int num_words) {
+  for (int i = 0; i < num_words; i += 2) {
+    __m128i a = _mm_load_si128((const __m128i *)(mask1 + i));
+    __m128i b = _mm_load_si128((const __m128i *)(mask2 + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xffff) {
+      return false;
+    }
+  }
+  return true;
+}
+
+__attribute__((target("sse2"))) static bool empty_sse2(const uint64_t *mask,
+                                                       int num_words) {
+  __m128i any = _mm_setzero_si128();
+  for (int i = 0; i < num_words; i += 2) {
+    any = _mm_or_si128(any, _mm_load_si128((const __m128i *)(mask + i)));
+  }
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) == 0xffff;
+}
+
+static const set_kernels sse2_kernels = {unify_sse2,    intersect_sse2,
+                                         diff_sse2,     transfer_sse2,
+                                         equals_sse2,   empty_sse2};
+
+/*********************************************************************
+ *                                                                   *
+ *                           AVX2 kernels                            *
+ *                                                                   *
+ *********************************************************************/
+
+// _mm256_andnot_si256(a, b) computes ~a & b
+#define AVX2_ANDNOT(a, b) _mm256_andnot_si256(b, a)
+
+#define AVX2_BINARY_KERNEL(name, op)                                           \
+  __attribute__((target("avx2"))) static bool name(                            \
+      uint64_t *target, const uint64_t *other, int num_words) {                \
+    __m256i changed = _mm256_setzero_si256();                                  \
+    for (int i = 0; i < num_words; i += 4) {                                   \
+      __m256i t = _mm256_load_si256((__m256i *)(target + i));                  \
+      __m256i o = _mm256_load_si256((const __m256i *)(other + i));             \
+      __m256i new_words = op(t, o);                                            \
+      changed = _mm256_or_si256(changed, _mm256_xor_si256(new_words, t));      \
+      _mm256_store_si256((__m256i *)(target + i), new_words);                  \
+    }                                                                          \
+    return !_mm256_testz_si256(changed, changed);                              \
+  }
+
+AVX2_BINARY_KERNEL(unify_avx2, _mm256_or_si256)
+AVX2_BINARY_KERNEL(intersect_avx2, _mm256_and_si256)
+AVX2_BINARY_KERNEL(diff_avx2, AVX2_ANDNOT)
+
+__attribute__((target("avx2"))) static bool
+transfer_avx2(uint64_t *target, const uint64_t *gen, const uint64_t *source,
+              const uint64_t *kill, int num_words) {
+  __m256i changed = _mm256_setzero_si256();
+  for (int i = 0; i < num_words; i += 4) {
+    __m256i t = _mm256_load_si256((__m256i *)(target + i));
+    __m256i g = _mm256_load_si256((const __m256i *)(gen + i));
+    __m256i s = _mm256_load_si256((const __m256i *)(source + i));
+    __m256i k = _mm256_load_si256((const __m256i *)(kill + i));
+    __m256i new_words = _mm256_or_si256(g, _mm256_andnot_si256(k, s));
+    changed = _mm256_or_si256(changed, _mm256_xor_si256(new_words, t));
+    _mm256_store_si256((__m256i *)(target + i), new_words);
+  }
+  return !_mm256_testz_si256(changed, changed);
+}
+
+__attribute__((target("avx2"))) static bool
+equals_avx2(const uint64_t *mask1, const uint64_t *mask2, int num_words) {
+  for (int i = 0; i < num_words; i += 4) {
+    __m256i a = _mm256_load_si256((const __m256i *)(mask1 + i));
+    __m256i b = _mm256_load_si256((const __m256i *)(mask2 + i));
+    __m256i diff = _mm256_xor_si256(a, b);
+    if (!_mm256_testz_si256(diff, diff)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+__attribute__((target("avx2"))) static bool empty_avx2(const uint64_t *mask,
+                                                       int num_words) {
+  __m256i any = _mm256_setzero_si256();
+  for (int i = 0; i < num_words; i += 4) {
+    any = _mm256_or_si256(any, _mm256_load_si256((const __m256i *)(mask + i)));
+  }
+  return _mm256_testz_si256(any, any);
+}
+
+static const set_kernels avx2_kernels = {unify_avx2,    intersect_avx2,
+                                         diff_avx2,     transfer_avx2,
+                                         equals_avx2,   empty_avx2};
+
+#endif // SET_X86_KERNELS
+
+/**
+ * Chooses the widest set kernels supported by the CPU running the compiler.
+ */
+void select_kernels() {
+  kernels = &scalar_kernels;
+#ifdef SET_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernels = &avx2_kernels;
+  } else if (__builtin_cpu_supports("sse2")) {
+    kernels = &sse2_kernels;
+  }
+#endif
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                      Dense and sparse storage                     *
+ *                                                                   *
+ *********************************************************************/
+
+// Bits of dense storage taken by each element of the sparse form
+#define BITS_PER_SPARSE_ELEMENT (8 * sizeof(int))
+
+/**
+ * Allocates a zeroed mask large enough for a set, aligned to a cache line.
+ *
+ * @param data: storage of the set
+ * @param max_size: maximum number of elements in the set
+ */
+static void allocate_mask(set_data *data, int max_size) {
+  // Round the number of words up to whole cache lines. There's always at least
+  // one cache line so that the kernels never see an empty mask.
+  int num_words = (max_size + BITS_PER_WORD - 1) / BITS_PER_WORD;
+  num_words = (num_words + WORDS_PER_CACHE_LINE - 1) / WORDS_PER_CACHE_LINE *
+              WORDS_PER_CACHE_LINE;
+  if (num_words == 0) {
+    num_words = WORDS_PER_CACHE_LINE;
+  }
+
+  data->dense = true;
+  data->num_words = num_words;
+  data->mask = aligned_alloc(CACHE_LINE_SIZE, num_words * sizeof(uint64_t));
+  if (data->mask == NULL) {
+    fprintf(stderr, "Not enough memory\n");
+    abort();
+  }
+  memset(data->mask, 0, num_words * sizeof(uint64_t));
+}
+
+/**
+ * Makes sure the sparse form of a set can hold a given number of elements.
+ *
+ * @param data: storage of the set
+ * @param capacity: number of elements
+ */
+static void reserve_elements(set_data *data, int capacity) {
+  if (capacity <= data->capacity) {
+    return;
+  }
+
+  int new_capacity = data->capacity > 0 ? 2 * data->capacity : 4;
+  while (new_capacity < capacity) {
+    new_capacity *= 2;
+  }
+  data->elements = realloc(data->elements, new_capacity * sizeof(int));
+  if (data->elements == NULL) {
+    fprintf(stderr, "Not enough memory\n");
+    abort();
+  }
+  data->capacity = new_capacity;
+}
+
+/**
+ * Converts a set in the sparse form to the dense form.
+ *
+ * @param set: set
+ */
+static void make_dense(set set) {
+  set_data *data = set.data;
+  allocate_mask(data, set.max_size);
+  for (int i = 0; i < data->size; i++) {
+    data->mask[data->elements[i] / BITS_PER_WORD] |=
+        1ULL << (data->elements[i] % BITS_PER_WORD);
+  }
+
+  free(data->elements);
+  data->elements = NULL;
+  data->size = 0;
+  data->capacity = 0;
+}
+
+/**
+ * Switches a sparse set to the dense form once its elements take more memory
+ * than a mask would.
+ *
+ * @param set: set
+ */
+static void update_representation(set set) {
+  if (!set.data->dense &&
+      (long long)set.data->size * BITS_PER_SPARSE_ELEMENT > set.max_size) {
+    make_dense(set);
+  }
+}
+
+/**
+ * Finds the position of the first element in a sparse set that is greater
+ * than or equal to a given element.
+ *
+ * @param data: storage of the set
+ * @param elto: element
+ *
+ * @return Position in the array of elements.
+ */
+static int find_position(set_data *data, int elto) {
+  int low = 0;
+  int high = data->size;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (data->elements[mid] < elto) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low;
+}
+
+/**
+ * Keeps in a sparse set only the elements that belong (or not) to another
+ * set.
+ *
+ * @param target: sparse set to be filtered
+ * @param other: set to check the elements against
+ * @param keep_members: whether to keep the elements that belong to the other
+ * set (intersection) or the ones that don't (difference)
+ *
+ * @return Whether the target set changed.
+ */
+static bool filter_sparse_set(set target, set other, bool keep_members) {
+  set_data *data = target.data;
+  int new_size = 0;
+  for (int i = 0; i < data->size; i++) {
+    if (does_elto_belong_to_set(data->elements[i], other) == keep_members) {
+      data->elements[new_size++] = data->elements[i];
+    }
+  }
+
+  bool changed = new_size != data->size;
+  data->size = new_size;
+
+  return changed;
+}
+
+/**
+ * Adds the elements of a sparse set to another sparse set by merging their
+ * sorted arrays.
+ *
+ * @param target: sparse set to be updated
+ * @param other: sparse set to add to the target
+ *
+ * @return Whether the target set changed.
+ */
+static bool merge_sparse_sets(set target, set other) {
+  set_data *data = target.data;
+  set_data *other_data = other.data;
+  if (other_data->size == 0) {
+    return false;
+  }
+
+  int *merged = malloc((data->size + other_data->size) * sizeof(int));
+  if (merged == NULL) {
+    fprintf(stderr, "Not enough memory\n");
+    abort();
+  }
+
+  int i = 0, j = 0, k = 0;
+  while (i < data->size || j < other_data->size) {
+    if (j == other_data->size ||
+        (i < data->size && data->elements[i] < other_data->elements[j])) {
+      merged[k++] = data->elements[i++];
+    } else if (i == data->size ||
+               other_data->elements[j] < data->elements[i]) {
+      merged[k++] = other_data->elements[j++];
+    } else {
+      merged[k++] = data->elements[i++];
+      j++;
+    }
+  }
+
+  bool changed = k != data->size;
+  free(data->elements);
+  data->elements = merged;
+  data->capacity = data->size + other_data->size;
+  data->size = k;
+  update_representation(target);
+
+  return changed;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                          Set operations                           *
+ *                                                                   *
+ *********************************************************************/
 
 bool is_set_undefined(set set) {
-  return set.mask == NULL;
+  return set.data == NULL;
 }
 
 set create_empty_set(int max_size) {
   set set;
 
+  if (!kernels) {
+    select_kernels();
+  }
+
   set.max_size = max_size;
-  set.num_partitions = ceil((double) max_size / BITS_PER_PARTITION);
-  set.mask = zalloc(fmax(1, set.num_partitions * BYTES_PER_PARTITION));
-  for (int i = 0; i < set.num_partitions; i++) {
-    set.mask[i] = 0;
+  set.data = zalloc(sizeof(set_data));
+  if (max_size <= SET_DENSE_MAX_SIZE) {
+    allocate_mask(set.data, max_size);
   }
 
   return set;
@@ -25,30 +463,55 @@ set create_empty_set(int max_size) {
 
 set create_full_set(int max_size) {
   set set = create_empty_set(max_size);
-  for (int i = 0; i < set.num_partitions - 1; i++) {
-    set.mask[i] = ~0;
+  if (!set.data->dense) {
+    make_dense(set);
   }
-  // In the last partition
-  int r = max_size % BITS_PER_PARTITION;
-  for (int i = 0; i < r; i++) {
-    // Left shift with trailling 1
-    set.mask[set.num_partitions - 1] <<= 1;
-    set.mask[set.num_partitions - 1] |= 1;
+
+  int num_full_words = max_size / BITS_PER_WORD;
+  for (int i = 0; i < num_full_words; i++) {
+    set.data->mask[i] = ~0ULL;
+  }
+  // In the last partial word
+  int r = max_size % BITS_PER_WORD;
+  if (r > 0) {
+    set.data->mask[num_full_words] = (1ULL << r) - 1;
   }
 
   return set;
 }
 
 void add_to_set(int elto, set set) {
-  int partition = elto / BITS_PER_PARTITION;
-  int pos_in_partition = elto % BITS_PER_PARTITION;
-  set.mask[partition] |= 1 << pos_in_partition;
+  set_data *data = set.data;
+  if (data->dense) {
+    data->mask[elto / BITS_PER_WORD] |= 1ULL << (elto % BITS_PER_WORD);
+    return;
+  }
+
+  int pos = find_position(data, elto);
+  if (pos < data->size && data->elements[pos] == elto) {
+    return;
+  }
+  reserve_elements(data, data->size + 1);
+  memmove(data->elements + pos + 1, data->elements + pos,
+          (data->size - pos) * sizeof(int));
+  data->elements[pos] = elto;
+  data->size++;
+  update_representation(set);
 }
 
 void remove_from_set(int elto, set set) {
-  int partition = elto / BITS_PER_PARTITION;
-  int pos_in_partition = elto % BITS_PER_PARTITION;
-  set.mask[partition] &= ~(1 << pos_in_partition);
+  set_data *data = set.data;
+  if (data->dense) {
+    data->mask[elto / BITS_PER_WORD] &= ~(1ULL << (elto % BITS_PER_WORD));
+    return;
+  }
+
+  int pos = find_position(data, elto);
+  if (pos < data->size && data->elements[pos] == elto) {
+    memmove(data->elements + pos, data->elements + pos + 1,
+            (data->size - pos - 1) * sizeof(int));
+    data->size--;
+  }
 }
 
 bool are_set_equals(set set1, set set2) {
@@ -56,8 +519,26 @@ bool are_set_equals(set set1, set set2) {
     return false;
   }
 
-  for (int i = 0; i < set1.num_partitions; i++) {
-    if (set1.mask[i] != set2.mask[i]) {
+  set_data *data1 = set1.data;
+  set_data *data2 = set2.data;
+  if (data1->dense && data2->dense) {
+    return kernels->equals(data1->mask, data2->mask, data1->num_words);
+  }
+
+  if (!data1->dense && !data2->dense) {
+    return data1->size == data2->size &&
+           memcmp(data1->elements, data2->elements, data1->size * sizeof(int)) ==
+               0;
+  }
+
+  // One sparse and one dense set
+  set sparse_set = data1->dense ? set2 : set1;
+  set dense_set = data1->dense ? set1 : set2;
+  if (get_set_size(dense_set) != sparse_set.data->size) {
+    return false;
+  }
+  for (int i = 0; i < sparse_set.data->size; i++) {
+    if (!does_elto_belong_to_set(sparse_set.data->elements[i], dense_set)) {
       return false;
     }
   }
@@ -66,57 +547,231 @@ bool are_set_equals(set set1, set set2) {
 }
 
 set unify_sets(set set1, set set2) {
-  set new_set = create_empty_set(set1.max_size);
-
-  for (int i = 0; i < set1.num_partitions; i++) {
-    new_set.mask[i] = set1.mask[i] | set2.mask[i];
-  }
+  set new_set = clone_set(set1);
+  unify_sets_in_place(new_set, set2);
 
   return new_set;
 }
 
 set intersect_sets(set set1, set set2) {
-  set new_set = create_empty_set(set1.max_size);
-
-  for (int i = 0; i < set1.num_partitions; i++) {
-    new_set.mask[i] = set1.mask[i] & set2.mask[i];
-  }
+  set new_set = clone_set(set1);
+  intersect_sets_in_place(new_set, set2);
 
   return new_set;
 }
 
 set diff_sets(set set1, set set2) {
-  set new_set = create_empty_set(set1.max_size);
-
-  for (int i = 0; i < set1.num_partitions; i++) {
-    new_set.mask[i] = set1.mask[i] & ~set2.mask[i];
-  }
+  set new_set = clone_set(set1);
+  diff_sets_in_place(new_set, set2);
 
   return new_set;
 }
 
 set clone_set(set original_set) {
   set cloned_set = create_empty_set(original_set.max_size);
-  cloned_set = unify_sets(cloned_set, original_set);
+  copy_set(cloned_set, original_set);
 
   return cloned_set;
 }
 
 bool is_set_empty(set set) {
-  for(int i = 0; i < set.num_partitions; i++) {
-    if(set.mask[i] != 0) {
-      return false;
-    }
+  if (!set.data->dense) {
+    return set.data->size == 0;
   }
 
-  return true;
+  return kernels->empty(set.data->mask, set.data->num_words);
 }
 
 bool does_elto_belong_to_set(int elto, set set) {
   if (is_set_undefined(set)) return false;
 
-  int partition = elto / BITS_PER_PARTITION;
-  int pos_in_partition = elto % BITS_PER_PARTITION;
-  int elto_mask = (1 << pos_in_partition);
-  return (set.mask[partition] & elto_mask) == elto_mask;
+  set_data *data = set.data;
+  if (data->dense) {
+    return (data->mask[elto / BITS_PER_WORD] >> (elto % BITS_PER_WORD)) & 1;
+  }
+
+  int pos = find_position(data, elto);
+  return pos < data->size && data->elements[pos] == elto;
+}
+
+int get_next_elto_in_set(int elto, set set) {
+  if (is_set_undefined(set) || elto < 0 || elto >= set.max_size) {
+    return -1;
+  }
+
+  set_data *data = set.data;
+  if (!data->dense) {
+    int pos = find_position(data, elto);
+    return pos < data->size ? data->elements[pos] : -1;
+  }
+
+  int word_idx = elto / BITS_PER_WORD;
+  // Ignore the elements before the starting one in its word
+  uint64_t word = data->mask[word_idx] & (~0ULL << (elto % BITS_PER_WORD));
+  while (word == 0) {
+    word_idx++;
+    if (word_idx >= data->num_words) {
+      return -1;
+    }
+    word = data->mask[word_idx];
+  }
+
+  return word_idx * BITS_PER_WORD + __builtin_ctzll(word);
+}
+
+int get_set_size(set set) {
+  if (!set.data->dense) {
+    return set.data->size;
+  }
+
+  int size = 0;
+  for (int i = 0; i < set.data->num_words; i++) {
+    size += __builtin_popcountll(set.data->mask[i]);
+  }
+
+  return size;
+}
+
+void free_set(set set) {
+  if (is_set_undefined(set)) {
+    return;
+  }
+
+  free(set.data->mask);
+  free(set.data->elements);
+  free(set.data);
+}
+
+void clear_set(set set) {
+  if (set.data->dense) {
+    memset(set.data->mask, 0, set.data->num_words * sizeof(uint64_t));
+  } else {
+    set.data->size = 0;
+  }
+}
+
+void copy_set(set target, set source) {
+  set_data *data = target.data;
+  set_data *source_data = source.data;
+
+  if (source_data->dense) {
+    if (!data->dense) {
+      make_dense(target);
+    }
+    memcpy(data->mask, source_data->mask, data->num_words * sizeof(uint64_t));
+  } else if (data->dense) {
+    clear_set(target);
+    for (int i = 0; i < source_data->size; i++) {
+      add_to_set(source_data->elements[i], target);
+    }
+  } else {
+    reserve_elements(data, source_data->size);
+    memcpy(data->elements, source_data->elements,
+           source_data->size * sizeof(int));
+    data->size = source_data->size;
+  }
+}
+
+bool unify_sets_in_place(set target, set other) {
+  set_data *data = target.data;
+  set_data *other_data = other.data;
+
+  if (other_data->dense) {
+    if (!data->dense) {
+      make_dense(target);
+    }
+    return kernels->unify(data->mask, other_data->mask, data->num_words);
+  }
+
+  if (!data->dense) {
+    return merge_sparse_sets(target, other);
+  }
+
+  bool changed = false;
+  for (int i = 0; i < other_data->size; i++) {
+    int elto = other_data->elements[i];
+    if (!does_elto_belong_to_set(elto, target)) {
+      add_to_set(elto, target);
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+bool intersect_sets_in_place(set target, set other) {
+  set_data *data = target.data;
+  set_data *other_data = other.data;
+
+  if (!data->dense) {
+    return filter_sparse_set(target, other, true);
+  }
+
+  if (other_data->dense) {
+    return kernels->intersect(data->mask, other_data->mask, data->num_words);
+  }
+
+  // Dense target and sparse other. Build the words of the other set on the
+  // fly from its sorted elements.
+  uint64_t changed = 0;
+  int i = 0;
+  for (int word_idx = 0; word_idx < data->num_words; word_idx++) {
+    uint64_t other_word = 0;
+    while (i < other_data->size &&
+           other_data->elements[i] / BITS_PER_WORD == word_idx) {
+      other_word |= 1ULL << (other_data->elements[i] % BITS_PER_WORD);
+      i++;
+    }
+    uint64_t new_word = data->mask[word_idx] & other_word;
+    changed |= new_word ^ data->mask[word_idx];
+    data->mask[word_idx] = new_word;
+  }
+
+  return changed != 0;
+}
+
+bool diff_sets_in_place(set target, set other) {
+  set_data *data = target.data;
+  set_data *other_data = other.data;
+
+  if (!data->dense) {
+    return filter_sparse_set(target, other, false);
+  }
+
+  if (other_data->dense) {
+    return kernels->diff(data->mask, other_data->mask, data->num_words);
+  }
+
+  bool changed = false;
+  for (int i = 0; i < other_data->size; i++) {
+    int elto = other_data->elements[i];
+    if (does_elto_belong_to_set(elto, target)) {
+      remove_from_set(elto, target);
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+bool apply_transfer_function(set target, set gen, set source, set kill) {
+  if (target.data->dense && gen.data->dense && source.data->dense &&
+      kill.data->dense) {
+    return kernels->transfer(target.data->mask, gen.data->mask,
+                             source.data->mask, kill.data->mask,
+                             target.data->num_words);
+  }
+
+  // At least one of the sets is sparse, so the result is built separately
+  // and only copied if it differs from the current one.
+  set result = clone_set(source);
+  diff_sets_in_place(result, kill);
+  unify_sets_in_place(result, gen);
+  bool changed = !are_set_equals(target, result);
+  if (changed) {
+    copy_set(target, result);
+  }
+  free_set(result);
+
+  return changed;
 }
\ No newline at end of file
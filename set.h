@@ -7,14 +7,40 @@
 #define CSC553_SET_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
-// Bit set for numbers from 0 to N. Each location of mask can store up to 32
-// elements.
-// Maximum number of elements it can have is 32*(2^64)
+// Sets whose maximum number of elements is up to this value are always
+// stored as bit masks. Larger sets start as sorted arrays of elements and
+// switch to bit masks once the array would take more memory than the mask.
+#ifndef SET_DENSE_MAX_SIZE
+#define SET_DENSE_MAX_SIZE 2048
+#endif
+
+// Storage of a set. In the dense form, each word of the mask stores up to 64
+// elements. The mask is aligned to a cache line and its number of words is
+// padded to a whole number of cache lines (the padding bits are always zero),
+// so the set operations can process it with vector instructions without
+// handling remainders. In the sparse form, the elements are kept in a sorted
+// array.
+typedef struct SetData {
+  bool dense;
+
+  // Dense form
+  int num_words;
+  uint64_t *mask;
+
+  // Sparse form
+  int size;
+  int capacity;
+  int *elements;
+} set_data;
+
+// Set for numbers from 0 to N. Copies of a set share the same storage, so
+// the representation can change inside any operation without invalidating
+// them.
 typedef struct Set {
   int max_size;
-  unsigned long long num_partitions;
-  unsigned int *mask;
+  set_data *data;
 } set;
 
 /**
@@ -64,4 +90,111 @@ bool is_set_empty(set set);
 
 bool does_elto_belong_to_set(int elto, set set);
 
+/**
+ * Finds the smallest element of a set that is greater than or equal to a
+ * given element. In the dense form, empty words are skipped and the element
+ * is located with a count-trailing-zeros instruction, so iterating over a set
+ * costs time proportional to its number of words plus its number of
+ * elements. In the sparse form, the element is found by binary search.
+ *
+ * @param elto: element to start the search from
+ * @param set: set
+ *
+ * @return Next element in the set or -1 if there is none.
+ */
+int get_next_elto_in_set(int elto, set set);
+
+/**
+ * Iterates over the elements of a set in increasing order. The set must not
+ * be changed during the iteration, except for the removal of elements
+ * already visited.
+ *
+ * @param elto: name of the int variable that receives each element
+ * @param set: set
+ */
+#define FOR_EACH_ELTO_IN_SET(elto, set)                                        \
+  for (int elto = get_next_elto_in_set(0, set); elto >= 0;                     \
+       elto = get_next_elto_in_set(elto + 1, set))
+
+/**
+ * Counts the number of elements in a set.
+ *
+ * @param set: set
+ *
+ * @return Cardinality of the set.
+ */
+int get_set_size(set set);
+
+/**
+ * Releases the memory used by a set. The set must not be used afterwards.
+ *
+ * @param set: set
+ */
+void free_set(set set);
+
+// In-place set operations. They write the result in the target set instead
+// of allocating a new one, so they can be used in the inner loops of the
+// data-flow analyses. They assume the sets have the same maximum number of
+// elements.
+
+/**
+ * Removes all the elements from a set.
+ *
+ * @param set: set
+ */
+void clear_set(set set);
+
+/**
+ * Copies the elements of a set into another one.
+ *
+ * @param target: set to be overwritten
+ * @param source: set to copy from
+ */
+void copy_set(set target, set source);
+
+/**
+ * Adds the elements of a set to the target set (target = target U other).
+ *
+ * @param target: set to be updated
+ * @param other: set to add to the target
+ *
+ * @return Whether the target set changed.
+ */
+bool unify_sets_in_place(set target, set other);
+
+/**
+ * Keeps in the target set only the elements also present in another set
+ * (target = target & other).
+ *
+ * @param target: set to be updated
+ * @param other: set to intersect with the target
+ *
+ * @return Whether the target set changed.
+ */
+bool intersect_sets_in_place(set target, set other);
+
+/**
+ * Removes from the target set the elements present in another set
+ * (target = target - other).
+ *
+ * @param target: set to be updated
+ * @param other: set with the elements to remove from the target
+ *
+ * @return Whether the target set changed.
+ */
+bool diff_sets_in_place(set target, set other);
+
+/**
+ * Applies a data-flow transfer function to a set:
+ * target = gen U (source - kill).
+ *
+ * @param target: set to store the result
+ * @param gen: generated elements
+ * @param source: set the transfer function is applied to
+ * @param kill: killed elements
+ *
+ * @return Whether the target set changed.
+ */
+bool apply_transfer_function(set target, set gen, set source, set kill);
+
 #endif
@@ -0,0 +1,177 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#include "shrink_wrapping.h"
+#include "code_optimization.h"
+
+static int FIRST_CALLEE_SAVED_REG = 8; // $s0
+
+static set *find_referenced_registers(int num_registers);
+static void add_register_of_variable(symtabnode *var, set registers);
+static bnode *find_common_dominator(bnode *block1, bnode *block2);
+static bool are_exits_dominated(bnode *block);
+static bool is_exit(bnode *block);
+
+void place_callee_saved_registers(symtabnode *function_header) {
+  int num_registers = function_header->registers_used.max_size;
+  int num_blocks = get_num_created_blocks();
+  bnode **blocks = get_all_blocks();
+  bnode *entry = NULL;
+  for (int id = 0; id < num_blocks; id++) {
+    blocks[id]->saved_registers = create_empty_set(num_registers);
+    blocks[id]->restored_registers = create_empty_set(num_registers);
+    if (blocks[id]->first_instruction->op_type == OP_Enter) {
+      entry = blocks[id];
+    }
+  }
+
+  set *referenced_registers = find_referenced_registers(num_registers);
+  for (int reg = FIRST_CALLEE_SAVED_REG; reg < num_registers; reg++) {
+    if (!does_elto_belong_to_set(reg, function_header->registers_used)) {
+      continue;
+    }
+
+    bnode *save_block = NULL;
+    for (int id = 0; id < num_blocks; id++) {
+      if (does_elto_belong_to_set(reg, referenced_registers[id])) {
+        save_block = save_block ? find_common_dominator(save_block, blocks[id])
+                                : blocks[id];
+      }
+    }
+    // Saves inside loops would run more than once
+    while (save_block && save_block->loop) {
+      save_block = save_block->idom;
+    }
+    if (!save_block || !are_exits_dominated(save_block)) {
+      save_block = entry;
+    }
+
+    add_to_set(reg, save_block->saved_registers);
+    for (int id = 0; id < num_blocks; id++) {
+      if (is_exit(blocks[id]) && dominates(save_block, blocks[id])) {
+        add_to_set(reg, blocks[id]->restored_registers);
+      }
+    }
+  }
+
+  for (int id = 0; id < num_blocks; id++) {
+    free_set(referenced_registers[id]);
+  }
+  free(referenced_registers);
+}
+
+/**
+ * Finds the registers referenced by the instructions of each block. The Enter
+ * instruction references the registers of the formals it loads.
+ *
+ * @param num_registers: number of registers available
+ *
+ * @return Array of sets of registers indexed by block id
+ */
+set *find_referenced_registers(int num_registers) {
+  int num_blocks = get_num_created_blocks();
+  bnode **blocks = get_all_blocks();
+  set *referenced_registers = zalloc((num_blocks + 1) * sizeof(set));
+  for (int id = 0; id < num_blocks; id++) {
+    set registers = create_empty_set(num_registers);
+    FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, blocks[id]) {
+      if (curr_instruction->dead) {
+        continue;
+      }
+
+      if (curr_instruction->op_type == OP_Enter) {
+        for (int i = 0; i < get_total_local_variables(); i++) {
+          if (get_variable_by_id(i)->formal) {
+            add_register_of_variable(get_variable_by_id(i), registers);
+          }
+        }
+      } else {
+        add_register_of_variable(SRC1(curr_instruction), registers);
+        add_register_of_variable(SRC2(curr_instruction), registers);
+        add_register_of_variable(curr_instruction->dest, registers);
+      }
+    }
+    referenced_registers[id] = registers;
+  }
+
+  return referenced_registers;
+}
+
+/**
+ * Adds the register allocated to a variable, if any, to a set.
+ *
+ * @param var: variable (possibly NULL)
+ * @param registers: set of registers
+ */
+void add_register_of_variable(symtabnode *var, set registers) {
+  if (var && var->live_range_node && var->live_range_node->reg >= 0) {
+    add_to_set(var->live_range_node->reg, registers);
+  }
+}
+
+/**
+ * Finds the nearest block that dominates two blocks.
+ *
+ * @param block1: block
+ * @param block2: another block
+ *
+ * @return Common dominator (NULL if they are in different dominator trees)
+ */
+bnode *find_common_dominator(bnode *block1, bnode *block2) {
+  while (block1 && !dominates(block1, block2)) {
+    block1 = block1->idom;
+  }
+  return block1;
+}
+
+/**
+ * Checks whether every block with a Return reachable from a block is
+ * dominated by it, so the registers it saves can be restored on every path.
+ *
+ * @param block: block
+ *
+ * @return
+ */
+bool are_exits_dominated(bnode *block) {
+  bool *visited = zalloc((get_num_created_blocks() + 1) * sizeof(bool));
+  bnode **stack = zalloc((get_num_created_blocks() + 1) * sizeof(bnode *));
+  int stack_size = 0;
+  bool dominated = true;
+  stack[stack_size++] = block;
+  visited[block->id] = true;
+  while (stack_size > 0 && dominated) {
+    bnode *curr_block = stack[--stack_size];
+    if (is_exit(curr_block) && !dominates(block, curr_block)) {
+      dominated = false;
+    }
+    for (int i = 0; i < curr_block->num_successors; i++) {
+      bnode *successor = curr_block->successors[i];
+      if (!visited[successor->id]) {
+        visited[successor->id] = true;
+        stack[stack_size++] = successor;
+      }
+    }
+  }
+  free(stack);
+  free(visited);
+
+  return dominated;
+}
+
+/**
+ * Checks whether a block returns from the function.
+ *
+ * @param block: block
+ *
+ * @return
+ */
+bool is_exit(bnode *block) {
+  FOR_EACH_INSTRUCTION_IN_BLOCK(curr_instruction, block) {
+    if (!curr_instruction->dead && curr_instruction->op_type == OP_Return) {
+      return true;
+    }
+  }
+  return false;
+}
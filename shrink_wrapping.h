@@ -0,0 +1,25 @@
+/*
+ * Author: Paulo Soares.
+ * CSC 553 (Spring 2021)
+ */
+
+#ifndef CSC553_SHRINK_WRAPPING_H
+#define CSC553_SHRINK_WRAPPING_H
+
+#include "control_flow.h"
+
+/**
+ * Chooses where the callee-saved registers used by a function are saved and
+ * restored. Each register is saved at the entry of the nearest block outside
+ * loops that dominates every reference to it, and restored by the Returns
+ * dominated by that block, so paths that never touch the register skip the
+ * save. If some Return reachable from that block is not dominated by it, the
+ * register is saved at the entry of the function instead. The results are
+ * stored in the saved_registers and restored_registers sets of the blocks.
+ *
+ * @param function_header: function entry in the symbol table, after register
+ * allocation
+ */
+void place_callee_saved_registers(symtabnode *function_header);
+
+#endif // CSC553_SHRINK_WRAPPING_H
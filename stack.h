@@ -6,7 +6,7 @@
 #ifndef CSC553_STACK_H
 #define CSC553_STACK_H
 
-#import "graph.h"
+#include "graph.h"
 
 /**
  * Adds a node to the stack
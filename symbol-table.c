@@ -59,7 +59,7 @@ void SymTabInit(int sc) {
     symtabnode* var = SymTab[sc][i];
     while(var) {
       symtabnode* next = var->next;
-      free(var->live_range_node);
+      free_graph_node(var->live_range_node);
       free(var->copied_to);
       var->live_range_node = NULL;
       var->copied_to = NULL;
@@ -140,7 +140,7 @@ symtabnode *SymTabInsert(char *str, int sc) {
   sptr = (symtabnode *)zalloc(sizeof(symtabnode));
   // Needed to copy the string to avoid having corrupted memory addresses for
   // the name of variables created by the compiler
-  sptr->name = malloc(strlen(str) * sizeof(char));
+  sptr->name = malloc((strlen(str) + 1) * sizeof(char));
   sptr->name = strcpy(sptr->name, str);
   sptr->scope = sc;
   sptr->live_range_node = NULL;
@@ -231,6 +231,7 @@ symtabnode *SymTabRecordFunInfo(bool isProto) {
     } else {
       stptr = SymTabInsert(ltmp->name, CurrScope);
       stptr->formal = true;
+      fill_id(stptr);
       if (ltmp->is_array) {
         stptr->type = t_Array;
         stptr->elt_type = ltmp->type;
@@ -363,6 +364,20 @@ symtabnode *create_temporary(int type) {
   return tmp;
 }
 
+symtabnode *create_split_variable(symtabnode *var, int part) {
+  char name[strlen(var->name) + 16];
+  sprintf(name, "%s.%d", var->name, part);
+  symtabnode *split_var = SymTabInsert(name, Local);
+  split_var->type = var->type;
+  split_var->is_temporary = var->is_temporary;
+  // Parts of a variable are never live at the same time
+  split_var->byte_size = var->byte_size;
+  split_var->fp_offset = var->fp_offset;
+  fill_id(split_var);
+
+  return split_var;
+}
+
 void free_temporary(symtabnode* tmp) {
   switch (tmp->type) {
   case t_Char:
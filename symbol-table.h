@@ -48,7 +48,10 @@ typedef struct stblnode {
   // used if the instruction is an assignment like one).
   struct stblnode* copied_from; // Stored during copy propagation
   var_list_node* copied_to; // List of variables
-  int cost; // Sum of frequencies of usage
+  long long cost; // Number of uses and definitions weighted by loop depth
+  bool is_rematerializable; // Its only definition assigns it a constant, so
+                            // it is recomputed instead of kept in memory
+  int remat_value;          // Constant that recomputes the variable
 
   set registers_used; // Store registers used in a function entry
   bool entered; // Indicates whether the body of the function has been processed
@@ -106,6 +109,17 @@ symtabnode *create_temporary(int type);
  */
 void free_temporary(symtabnode* tmp);
 
+/**
+ * Creates a local entry for a part of the live range of a variable. It shares
+ * the memory location of the variable.
+ *
+ * @param var: variable
+ * @param part: number of the part, unique among the parts of the variable
+ *
+ * @return pointer to the newly created entry
+ */
+symtabnode *create_split_variable(symtabnode *var, int part);
+
 /**
  * Creates a symbol table node to contain a string constant. This node is not
  * added to the symbol table, but collected separately.